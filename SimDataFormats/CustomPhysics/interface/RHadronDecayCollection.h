@@ -0,0 +1,29 @@
+#ifndef SimDataFormats_CustomPhysics_RHadronDecayCollection_H
+#define SimDataFormats_CustomPhysics_RHadronDecayCollection_H
+
+#include <vector>
+
+// R-hadron decays of one event, produced by RHDecayTracer from the decays recorded by RHadronPythiaDecayer.
+// The daughters of decays[i] are daughters[decays[i].firstDaughter] up to daughters[decays[i].lastDaughter].
+// Geant4 units: momenta and energies in MeV, positions in mm and times in ns.
+
+struct RHadronDecayDaughter {
+  int trackID = 0;
+  int pdgID = 0;
+  float px = 0, py = 0, pz = 0, energy = 0;
+};
+
+struct RHadronDecay {
+  int trackID = 0;            // Geant4 track ID of the decaying R-hadron
+  int genParticleIndex = -1;  // Barcode of its GenParticle in the generatorSmeared HepMC event, -1 if it has none
+  int pdgID = 0;
+  double x = 0, y = 0, z = 0, time = 0;  // Decay vertex
+  unsigned int firstDaughter = 0, lastDaughter = 0;
+};
+
+struct RHadronDecayCollection {
+  std::vector<RHadronDecay> decays;
+  std::vector<RHadronDecayDaughter> daughters;
+};
+
+#endif
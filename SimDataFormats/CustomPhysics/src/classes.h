@@ -0,0 +1,2 @@
+#include "SimDataFormats/CustomPhysics/interface/RHadronDecayCollection.h"
+#include "DataFormats/Common/interface/Wrapper.h"
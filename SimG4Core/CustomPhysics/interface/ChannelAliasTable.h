@@ -0,0 +1,66 @@
+#ifndef SimG4Core_CustomPhysics_ChannelAliasTable_H
+#define SimG4Core_CustomPhysics_ChannelAliasTable_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Walker alias tables for the reaction channel selection of the flat model of G4ProcessHelper, one table per sqrt(s)
+// bin. A bin covers the first n channels of a threshold-sorted channel list, and sample() picks one of them with a
+// single uniform number.
+//
+// channelWeights() gives the selection probabilities of the rejection loop the tables replace: a 2 -> 2 channel is
+// proposed with probability p22 (1 or 0 if the other class is empty) and a 2 -> 3 channel with 1 - p22, uniformly
+// within the class; 2 -> 3 channels are accepted with their phase space factor and channels changing the charge of the
+// leading particle are rejected with probability suppression, and rejected proposals are drawn again.
+
+class ChannelAliasTable {
+public:
+  struct Channel {
+    bool twoBody;
+    double acceptance;  // Phase space factor of 2 -> 3 channels, ignored for 2 -> 2
+    bool chargeChange;
+  };
+
+  // Normalised selection probabilities of the channels
+  static void channelWeights(
+      const std::vector<Channel>& channels, double p22, double suppression, std::vector<double>& weights);
+
+  // Adds a bin with the given (not necessarily normalised) weights, returns its index
+  std::size_t addBin(const std::vector<double>& weights);
+
+  std::size_t size() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+  std::size_t binSize(std::size_t bin) const { return offsets_[bin + 1] - offsets_[bin]; }
+
+  // Channel index for a uniform number u in [0, 1)
+  std::size_t sample(std::size_t bin, double u) const {
+    const std::uint32_t offset = offsets_[bin];
+    const std::size_t n = offsets_[bin + 1] - offset;
+    const double x = u * n;
+    const std::size_t k = std::min(static_cast<std::size_t>(x), n - 1);
+    return (x - k < probability_[offset + k]) ? k : alias_[offset + k];
+  }
+
+  // Channel index drawn from the bin and kept with probability ratio(index), drawn again otherwise. With the weights of
+  // the bin evaluated at an upper bound of the acceptances, and ratio the exact acceptance over that bound, the result
+  // follows the weights at the exact acceptances. As the rejection loop, it keeps the proposal of the last of maxTries
+  template <typename Uniform, typename Ratio>
+  std::size_t sample(std::size_t bin, Uniform& uniform, const Ratio& ratio, int maxTries = 100) const {
+    std::size_t k = sample(bin, uniform());
+    for (int tries = 1; tries < maxTries; ++tries) {
+      const double r = ratio(k);
+      if (r >= 1. || uniform() < r)
+        break;
+      k = sample(bin, uniform());
+    }
+    return k;
+  }
+
+private:
+  std::vector<std::uint32_t> offsets_;  // Start of each bin in the arrays below, and their total size
+  std::vector<float> probability_;      // Probability of keeping the channel of a slot rather than its alias
+  std::vector<std::uint16_t> alias_;
+};
+
+#endif
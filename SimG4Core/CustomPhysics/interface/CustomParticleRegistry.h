@@ -0,0 +1,62 @@
+#ifndef SimG4Core_CustomPhysics_CustomParticleRegistry_H
+#define SimG4Core_CustomPhysics_CustomParticleRegistry_H
+
+#include "globals.hh"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+class G4ParticleDefinition;
+
+// Properties of the particles used by the R-hadron hadronic interactions, cached once so that the stepping code does
+// not need G4ParticleTable::FindParticle, particle type strings or CustomPDGParser per call.
+// Particles are added while reading the process definitions, then build() assigns each PDG id a dense index.
+
+class CustomParticleRegistry {
+public:
+  enum Class : unsigned int {
+    kRHadronType = 1 << 0,  // Particle type "rhadron", "mesonino" or "sbaryon"
+    kMesonino = 1 << 1,
+    kSbaryon = 1 << 2,
+    kRMeson = 1 << 3,
+    kRBaryon = 1 << 4,
+    kRGlueball = 1 << 5,
+    kCustomParticle = 1 << 6  // Instance of CustomParticle
+  };
+
+  struct Entry {
+    G4ParticleDefinition* definition;
+    G4ParticleDefinition* cloud;  // Quark cloud of a CustomParticle, nullptr otherwise
+    G4double mass;
+    G4double charge;
+    unsigned int classes;                 // Class bits
+    std::array<unsigned char, 6> quarks;  // Number of contained d, u, s, c, b and t (anti)quarks of an R-hadron
+
+    bool is(unsigned int aClass) const { return (classes & aClass) != 0; }
+  };
+
+  // Adds a particle, ignoring duplicates and null pointers. Invalidates the indices
+  void add(G4ParticleDefinition* aParticle);
+  // Sorts the particles by PDG id
+  void build();
+
+  // Dense index of a PDG id, -1 if it is not registered
+  int index(G4int pdgCode) const {
+    const auto it = std::lower_bound(codes_.begin(), codes_.end(), pdgCode);
+    return (it != codes_.end() && *it == pdgCode) ? static_cast<int>(it - codes_.begin()) : -1;
+  }
+  const Entry& operator[](int index) const { return entries_[index]; }
+  // nullptr if the PDG id is not registered
+  const Entry* find(G4int pdgCode) const {
+    const int i = index(pdgCode);
+    return i >= 0 ? &entries_[i] : nullptr;
+  }
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  std::vector<G4int> codes_;  // Sorted PDG ids
+  std::vector<Entry> entries_;
+};
+
+#endif
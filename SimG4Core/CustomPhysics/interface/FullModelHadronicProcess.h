@@ -0,0 +1,82 @@
+#ifndef FullModelHadronicProcess_h
+#define FullModelHadronicProcess_h 1
+
+#include "globals.hh"
+#include "G4VDiscreteProcess.hh"
+#include "G4Nucleus.hh"
+#include "G4ReactionProduct.hh"
+#include "G4HadProjectile.hh"
+#include "G4FastVector.hh"
+#include "G4LorentzRotation.hh"
+#include "G4Proton.hh"
+#include "G4Neutron.hh"
+#include "G4KaonPlus.hh"
+#include <unordered_set>
+#include <vector>
+
+#include "SimG4Core/CustomPhysics/interface/FullModelReactionDynamics.h"
+
+class G4ProcessHelper;
+class G4Region;
+
+class FullModelHadronicProcess : public G4VDiscreteProcess {
+public:
+  FullModelHadronicProcess(G4ProcessHelper* aHelper, const G4String& processName = "FullModelHadronicProcess");
+
+  ~FullModelHadronicProcess() override;
+
+  G4bool IsApplicable(const G4ParticleDefinition& aP) override;
+
+  //Fills the per-material data of the helper for all materials
+  void BuildPhysicsTable(const G4ParticleDefinition& aP) override;
+
+  G4VParticleChange* PostStepDoIt(const G4Track& aTrack, const G4Step& aStep) override;
+
+protected:
+  G4double GetMeanFreePath(const G4Track& aTrack, G4double, G4ForceCondition*) override;
+
+  //Mean free path of the majorant cross section in the region and material of the track, for delta tracking
+  G4double MajorantMeanFreePath(const G4Track& aTrack);
+
+private:
+  virtual G4double GetMicroscopicCrossSection(const G4DynamicParticle* aParticle,
+                                              const G4Element* anElement,
+                                              G4double aTemp);
+
+  void CalculateMomenta(G4FastVector<G4ReactionProduct, MYGHADLISTSIZE>& secondaryParticleVector,
+                        G4int& secondaryParticleVectorLen,
+                        const G4HadProjectile* incomingCloudG4HadProjectile,
+                        const G4DynamicParticle* outgoingTargetG4Dynamic,
+                        G4ReactionProduct& modifiedoutgoingCloudG4Reaction,
+                        G4Nucleus& targetNucleus,
+                        G4ReactionProduct& outgoingCloudG4Reaction,
+                        G4ReactionProduct& outgoingTargetG4Reaction,
+                        G4bool& incomingRhadronHasChanged,
+                        G4bool& targetHasChanged);
+
+  G4bool MarkLeadingStrangeParticle(const G4ReactionProduct& outgoingCloudG4Reaction,
+                                    const G4ReactionProduct& outgoingTargetG4Reaction,
+                                    G4ReactionProduct& leadParticle);
+
+  void Rotate(G4FastVector<G4ReactionProduct, MYGHADLISTSIZE>& secondaryParticleVector,
+              G4int& secondaryParticleVectorLen);
+
+  G4ProcessHelper* theHelper;
+  G4ThreeVector incomingCloud3Momentum;
+  //Stateless, kept with the (per-thread) process rather than constructed for every interaction
+  FullModelReactionDynamics theReactionDynamics;
+
+  //Last majorant cross section per nucleon and material factor of the region, and the particle, region and kinetic
+  //energy they were computed for
+  const G4ParticleDefinition* majorantParticle;
+  const G4Region* majorantRegion;
+  G4double majorantKineticEnergy;
+  G4double majorantCrossSection;
+  G4double majorantRegionFactor;
+  //The current step was sampled with the majorant
+  G4bool majorantSampled;
+  //Regions where an interaction exceeded the majorant, tracked with the exact mean free path
+  std::unordered_set<const G4Region*> exactRegions;
+};
+
+#endif
@@ -5,19 +5,45 @@
 #include "G4ParticleDefinition.hh"
 #include "G4DynamicParticle.hh"
 #include "G4Element.hh"
+#include "G4Material.hh"
 #include "G4Track.hh"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "SimG4Core/CustomPhysics/interface/ChannelAliasTable.h"
+#include "SimG4Core/CustomPhysics/interface/CustomParticleRegistry.h"
 
 #include <vector>
 #include <map>
+#include <unordered_map>
+
+//The PDG codes of the products of a reaction, stored inline. The process definitions have 2 -> 2 and 2 -> 3 reactions
+class ReactionProduct {
+public:
+  static constexpr size_t kMaxProducts = 3;
+  typedef const G4int* const_iterator;
+
+  ReactionProduct() : nProducts(0) {}
+
+  //The caller checks that there is room
+  void push_back(G4int aPDGCode) { products[nProducts++] = aPDGCode; }
+
+  size_t size() const { return nProducts; }
+  bool empty() const { return nProducts == 0; }
+  G4int operator[](size_t i) const { return products[i]; }
+  const_iterator begin() const { return products; }
+  const_iterator end() const { return products + nProducts; }
+
+private:
+  G4int products[kMaxProducts];
+  size_t nProducts;
+};
 
 //Typedefs just made to make life easier :-)
-typedef std::vector<G4int> ReactionProduct;
 typedef std::vector<ReactionProduct> ReactionProductList;
 typedef std::map<G4int, ReactionProductList> ReactionMap;
 
 class G4ParticleTable;
+class G4Region;
 class CustomParticleFactory;
 class HistoHelper;
 class TProfile;
@@ -33,41 +59,126 @@ public:
 
   G4double GetInclusiveCrossSection(const G4DynamicParticle* aParticle, const G4Element* anElement);
 
+  //The inclusive cross section factorises into a cross section per nucleon of the R-hadron and a factor of the element
+  G4double GetCrossSectionPerNucleon(const G4DynamicParticle* aParticle);
+  G4double ElementFactor(const G4Element* anElement);
+
+  //Per-material invariants, by material index: the sum over the elements of the atomic number density times the
+  //element factor, so that the macroscopic cross section is this times the cross section per nucleon, and the fraction
+  //of protons among the nucleons, which decides the target of an interaction
+  void BuildMaterialData();
+  G4double MaterialFactor(const G4Material* aMaterial) { return GetMaterialData(aMaterial).crossSectionFactor; }
+  G4double ProtonFraction(const G4Material* aMaterial) { return GetMaterialData(aMaterial).protonFraction; }
+  //True when the cross sections are evaluated analytically on every call instead of tabulated
+  G4bool AnalyticCrossSections() const { return analyticCrossSections; }
+
+  //Delta tracking: interactions are sampled with a majorant of the cross section in each region and accepted with
+  //the ratio of the cross section at the interaction point to it. Needs the tabulated cross sections
+  G4bool WoodcockTracking() const { return woodcockTracking; }
+  //Upper bound of the cross section per nucleon at the energy of the particle and at all lower energies
+  G4double GetMajorantCrossSectionPerNucleon(const G4DynamicParticle* aParticle);
+  //Largest material factor of the materials of a region
+  G4double RegionMaterialFactor(const G4Region* aRegion);
+
+  //The custom particles and all particles of the process definitions
+  const CustomParticleRegistry& GetParticleRegistry() const { return particleRegistry; }
+
   //Make sure the element is known (for n/p-decision)
-  ReactionProduct GetFinalState(const G4Track& aTrack, G4ParticleDefinition*& aTarget);
+  //The returned reaction lives in the channel tables of the helper
+  const ReactionProduct& GetFinalState(const G4Track& aTrack, G4ParticleDefinition*& aTarget);
 
   G4ProcessHelper(const G4ProcessHelper&) = delete;
   G4ProcessHelper& operator=(const G4ProcessHelper&) = delete;
 
 private:
+  //Cross section per nucleon of one R-hadron species, tabulated in log(boost) at construction
+  struct CrossSectionTable {
+    std::vector<G4double> nonResonant;     //Flat or Regge model part, at boost = exp(i * logBoostStep)
+    std::vector<G4double> nonResonantMax;  //Maximum of nonResonant up to point i + 1, bounds the interpolation
+    G4double resonanceE0;                  //Resonance position in sqrt(s)
+    G4double m2PlusMp2;                    //m^2 + m_p^2, so that s = m2PlusMp2 + 2 E m_p
+  };
+
+  //One reaction of the process definitions with the properties needed to select it
+  struct ReactionChannel {
+    ReactionProduct products;
+    G4double massSum;        //Sum of the rest masses of the products, the sqrt(s) threshold
+    G4double leadingCharge;  //Charge of the first product
+    G4bool givesBaryon;      //An R-baryon or sbaryon is produced
+  };
+
+  //The reactions of one incident on one target, each list sorted by threshold, so that the open channels at a given
+  //sqrt(s) are the first OpenChannels() entries
+  struct ChannelTable {
+    std::vector<ReactionChannel> all;
+    std::vector<ReactionChannel> baryonic;     //Regge model, baryonising interactions
+    std::vector<ReactionChannel> nonBaryonic;  //Regge model, other interactions
+    //Flat model: alias tables over the channels of all, by sqrt(s) bin starting at sqrtsBinEdges
+    std::vector<G4double> sqrtsBinEdges;
+    ChannelAliasTable flatModel;
+  };
+
+  struct MaterialData {
+    G4double crossSectionFactor;
+    G4double protonFraction;
+    G4bool filled;
+  };
+
+  const MaterialData& GetMaterialData(const G4Material* aMaterial) {
+    const size_t index = aMaterial->GetIndex();
+    if (index >= materialData.size() || !materialData[index].filled)
+      FillMaterialData(aMaterial);
+    return materialData[index];
+  }
+  void FillMaterialData(const G4Material* aMaterial);
+
   G4double Regge(const double boost);
   G4double Pom(const double boost);
 
+  //The original analytic evaluation, used with analyticCrossSections and beyond the tabulated range
+  G4double AnalyticCrossSectionPerNucleon(const G4DynamicParticle* aParticle);
+  G4double NonResonantCrossSection(const CustomParticleRegistry::Entry& anEntry, double boost);
+  void BuildCrossSectionTable(const G4ParticleDefinition* aParticle);
+  const CrossSectionTable* FindCrossSectionTable(const G4ParticleDefinition* aParticle);
+
+  void CompileChannelTables(const ReactionMap& pReactionMap, const ReactionMap& nReactionMap);
+  static size_t OpenChannels(const std::vector<ReactionChannel>& channels, G4double sqrts);
+  void BuildFlatModelBins(ChannelTable& table, G4double incidentCharge);
+  //Upper bound of the phase space factor of a channel in a flat model bin
+  G4double AcceptanceBound(const ChannelTable& table, size_t bin, const ReactionChannel& channel);
+
   G4double checkfraction;
   G4int n_22;
   G4int n_23;
 
-  G4ParticleDefinition* theTarget;
   G4ParticleDefinition* theProton;
   G4ParticleDefinition* theNeutron;
   G4ParticleDefinition* theRmesoncloud;
   G4ParticleDefinition* theRbaryoncloud;
 
-  ReactionMap* theReactionMap;
-
-  G4double PhaseSpace(const ReactionProduct& aReaction, const G4DynamicParticle* aDynamicParticle);
-
-  G4double ReactionProductMass(const ReactionProduct& aReaction, const G4DynamicParticle* aDynamicParticle);
-
-  G4bool ReactionGivesBaryon(const ReactionProduct& aReaction);
-
-  G4bool ReactionIsPossible(const ReactionProduct& aReaction, const G4DynamicParticle* aDynamicParticle);
+  G4double PhaseSpace(G4double qValue);
 
   void ReadAndParse(const G4String& str, std::vector<G4String>& tokens, const G4String& delimiters = " ");
 
   //Map of applicable particles
   std::map<const G4ParticleDefinition*, G4bool> known_particles;
 
+  CustomParticleRegistry particleRegistry;
+
+  //Channel tables by 2 * (registry index of the incident) + 0 for a proton, 1 for a neutron target
+  std::vector<ChannelTable> channelTables;
+
+  //Cross section tables of the applicable particles, and the last one used
+  bool analyticCrossSections;
+  bool woodcockTracking;
+  std::unordered_map<const G4ParticleDefinition*, CrossSectionTable> crossSectionTables;
+  const G4ParticleDefinition* lastTableParticle;
+  const CrossSectionTable* lastTable;
+  //pow(N, 0.7) * 1.25 by element index
+  std::vector<G4double> elementFactors;
+  std::vector<MaterialData> materialData;
+  std::unordered_map<const G4Region*, G4double> regionMaterialFactors;
+
   //Map for physics parameters, name to value
   std::map<G4String, G4double> parameters;
 
@@ -80,12 +191,6 @@ private:
   bool reggemodel;
   double mixing;
 
-  //Proton-scattering processes
-  ReactionMap pReactionMap;
-
-  //Neutron-scattering processes
-  ReactionMap nReactionMap;
-
   CustomParticleFactory* fParticleFactory;
   G4ParticleTable* particleTable;
   HistoHelper* theHistoHelper;
@@ -0,0 +1,31 @@
+#ifndef SimG4Core_CustomPhysics_RHDecayRecordPublisher_H
+#define SimG4Core_CustomPhysics_RHDecayRecordPublisher_H
+
+#include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayDataManager.h"
+#include "SimG4Core/Notification/interface/Observer.h"
+#include "SimG4Core/Notification/interface/BeginOfEvent.h"
+#include "SimG4Core/Watcher/interface/SimProducer.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+
+#include <memory>
+
+// Watcher of g4SimHits that ties the R-hadron decays recorded by RHadronPythiaDecayer to the edm::EventID of the event,
+// for RHDecayTracer. At the beginning of each Geant4 event it opens the decay record of the event, and drops that of the
+// previous event of the stream if RHDecayTracer did not take it; once the event is simulated it publishes the record.
+// It also streams the record to the decay record file, if one is configured. The last instance, destroyed with the
+// Geant4 workers at the end of the job, writes the decay timing report and completes the decay record file.
+// RHDecayTracer needs this watcher in g4SimHits.Watchers; the customise of Exotica_HSCP_SIM_cfi adds it.
+class RHDecayRecordPublisher : public SimProducer, public Observer<const BeginOfEvent*> {
+public:
+  RHDecayRecordPublisher(edm::ParameterSet const& p);
+  ~RHDecayRecordPublisher() override;
+  void produce(edm::Event& iEvent, const edm::EventSetup&) override;
+
+private:
+  void update(const BeginOfEvent*) override;
+
+  std::shared_ptr<RHadronPythiaDecayDataManager::EventRecord> record_; // Record of the event being simulated
+  std::shared_ptr<RHadronPythiaDecayDataManager::EventRecord> published_; // Record of the previous event
+};
+
+#endif
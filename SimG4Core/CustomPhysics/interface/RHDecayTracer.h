@@ -1,36 +1,42 @@
 #ifndef SimG4Core_CustomPhysics_RHDecayTracer_H
 #define SimG4Core_CustomPhysics_RHDecayTracer_H
 
+#include "SimDataFormats/CustomPhysics/interface/RHadronDecayCollection.h"
 #include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayDataManager.h"
+#include "SimG4Core/CustomPhysics/interface/SimTrackIndex.h"
 #include "SimDataFormats/Track/interface/SimTrackContainer.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
-#include "FWCore/Framework/interface/one/EDProducer.h"
-#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
 
 class SimTrack;
 
 namespace HepMC {
-  class GenVertex;
+  class GenEvent;
 }
 
 namespace edm {
   class HepMCProduct;
 }
 
-class RHDecayTracer : public edm::one::EDProducer<edm::one::SharedResources> {
+// Stream producer of the R-hadron decays of each event as an RHadronDecayCollection. With mergeIntoHepMC it also
+// produces a copy of the generatorSmeared HepMC event in which each decayed R-hadron gets a decay vertex with its
+// daughters; the generatorSmeared product itself is never modified.
+// The decays are only handed over by the RHDecayRecordPublisher watcher, which must be added to g4SimHits.Watchers as
+// the customise of Exotica_HSCP_SIM_cfi does. Without it every collection is empty and a warning is given.
+class RHDecayTracer : public edm::stream::EDProducer<> {
 public:
   RHDecayTracer(edm::ParameterSet const& p);
   ~RHDecayTracer() override = default;
   void produce(edm::Event &, const edm::EventSetup &) override;
 
 private:
-  const SimTrack* findSimTrack(int trackID, const edm::SimTrackContainer& simTracks);
-  void addSecondariesToGenVertex(std::map<int, std::vector<RHadronPythiaDecayDataManager::TrackData>> decayDaughters, const int decayID, HepMC::GenVertex* decayVertex);
+  void addDecaysToGenEvent(const RHadronDecayCollection& decays, HepMC::GenEvent& mcEvent) const;
 
+  const bool mergeIntoHepMC_;
   edm::EDGetTokenT<edm::HepMCProduct> genToken_;
   edm::EDGetTokenT<edm::SimTrackContainer> simTrackToken_;
-  edm::Handle<edm::HepMCProduct> genHandle_;
-  edm::Handle<edm::SimTrackContainer> simTrackHandle_;
+  RHadronPythiaDecayDataManager::DecayRecords decays_; // Decays of the current event, swapped in from the manager
+  SimTrackIndex simTrackIndex_; // Track ID -> SimTrack of the current event
 };
 
-#endif
\ No newline at end of file
+#endif
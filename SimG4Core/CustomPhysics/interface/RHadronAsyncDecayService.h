@@ -0,0 +1,65 @@
+#ifndef SimG4Core_CustomPhysics_RHadronAsyncDecayService_H
+#define SimG4Core_CustomPhysics_RHadronAsyncDecayService_H
+
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayLibrary.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Pythia8 {
+  class Pythia;
+}
+
+// Pool of helper threads decaying R-hadrons at rest with their own Pythia8 instances, so that the decay of an R-hadron
+// runs while Geant4 is still transporting it. The decay is requested when the R-hadron track starts, and collected,
+// then boosted to the lab frame, when it reaches its decay point; the decay itself stays synchronous for Geant4.
+// Requests of tracks that end without decaying are cancelled. Each request carries its own seed, so the result does not
+// depend on which helper thread runs it.
+
+class RHadronAsyncDecayService {
+public:
+  typedef std::vector<RHadronDecayLibrary::Product> Decay;
+  // Decay one R-hadron at rest with the given instance. Returns false if Pythia8 failed
+  typedef std::function<bool(Pythia8::Pythia&, int pdgId, double mass, Decay&)> DecayFunction;
+
+  // One helper thread per initialized Pythia8 instance
+  RHadronAsyncDecayService(std::vector<std::unique_ptr<Pythia8::Pythia>> engines, DecayFunction decayFunction);
+  ~RHadronAsyncDecayService();
+
+  struct Ticket {
+    std::uint64_t id;
+    std::future<Decay> decay;  // Holds an empty decay if Pythia8 failed
+  };
+  Ticket submit(int pdgId, double mass, int seed);
+  // Removes the request from the queue if no helper thread has started it; its future is then abandoned
+  void cancel(std::uint64_t id);
+
+private:
+  struct Request {
+    std::uint64_t id;
+    int pdgId;
+    double mass;
+    int seed;
+    std::promise<Decay> result;
+  };
+
+  void run(Pythia8::Pythia& pythia);
+
+  std::vector<std::unique_ptr<Pythia8::Pythia>> engines_;
+  DecayFunction decayFunction_;
+  std::mutex mutex_;
+  std::condition_variable wakeUp_;
+  std::deque<Request> queue_;
+  std::uint64_t nextId_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+
+#endif
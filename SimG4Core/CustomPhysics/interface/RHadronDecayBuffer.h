@@ -0,0 +1,57 @@
+#ifndef SimG4Core_CustomPhysics_RHadronDecayBuffer_H
+#define SimG4Core_CustomPhysics_RHadronDecayBuffer_H
+
+#include "G4LorentzVector.hh"
+#include "G4ThreeVector.hh"
+
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays buffer of the products of one R-hadron decay, as given by Pythia8 (GeV, mm, mm/c) in the frame of
+// the R-hadron or in the lab frame. toLab() boosts, converts and translates all products in one vectorizable pass,
+// after which momenta are in MeV, displacements are relative to the decay location and vertices are absolute.
+// The buffer keeps its capacity between decays.
+
+class RHadronDecayBuffer {
+public:
+  RHadronDecayBuffer() : size_(0) {}
+
+  void clear() { size_ = 0; }
+  std::size_t size() const { return size_; }
+
+  void add(int pdgId, int status, const double p[4], const double vProd[4], const double vDec[4]);
+  void add(int pdgId, int status, double px, double py, double pz, double e, double xProd, double yProd, double zProd,
+           double tProd, double xDec, double yDec, double zDec, double tDec);
+
+  // Boost by beta (zero when the products are already in the lab frame), convert GeV to MeV and place the vertices around origin
+  void toLab(const G4ThreeVector& beta, const G4ThreeVector& origin);
+
+  int pdgId(std::size_t i) const { return pdgId_[i]; }
+  int status(std::size_t i) const { return status_[i]; }
+  G4LorentzVector p4(std::size_t i) const { return G4LorentzVector(px_[i], py_[i], pz_[i], e_[i]); }
+  G4ThreeVector displacement(std::size_t i) const { return G4ThreeVector(dx_[i], dy_[i], dz_[i]); }
+
+  // Absolute production and decay vertices, for the containment test
+  const double* xProd() const { return xProd_.data(); }
+  const double* yProd() const { return yProd_.data(); }
+  const double* zProd() const { return zProd_.data(); }
+  const double* xDec() const { return xDec_.data(); }
+  const double* yDec() const { return yDec_.data(); }
+  const double* zDec() const { return zDec_.data(); }
+  // 1 for decayed products, whose decay vertex must be tested
+  const unsigned char* decayed() const { return decayed_.data(); }
+
+private:
+  void grow();
+
+  // The arrays are only ever grown, size_ is the number of products of the current decay
+  std::size_t size_;
+  std::vector<int> pdgId_, status_;
+  std::vector<unsigned char> decayed_;
+  std::vector<double> px_, py_, pz_, e_;
+  std::vector<double> dx_, dy_, dz_, dt_;  // Production vertex relative to the decay location
+  std::vector<double> xProd_, yProd_, zProd_;
+  std::vector<double> xDec_, yDec_, zDec_, tDec_;
+};
+
+#endif
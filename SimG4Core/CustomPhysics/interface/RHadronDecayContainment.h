@@ -0,0 +1,45 @@
+#ifndef SimG4Core_CustomPhysics_RHadronDecayContainment_H
+#define SimG4Core_CustomPhysics_RHadronDecayContainment_H
+
+#include "G4ThreeVector.hh"
+
+#include <cstddef>
+#include <vector>
+
+class G4VSolid;
+
+// Containment test for the vertices of the products of one R-hadron decay.
+// The extent of the world solid is cached once: points outside its bounding box are rejected and points inside a box
+// known to lie within the solid are accepted without navigation, so G4VSolid::Inside is only called near the boundary.
+// An optional acceptance cylinder (radius, half-length around the z axis, in mm) drops products which can never reach
+// a sensitive volume. Points on the surface of the world count as contained, as with G4VSolid::Inside.
+//
+// Points are given as coordinate arrays, e.g. those of RHadronDecayBuffer.
+
+class RHadronDecayContainment {
+public:
+  RHadronDecayContainment(double envelopeRadius, double envelopeHalfLength);
+
+  bool hasWorld() const { return world_ != nullptr; }
+  void setWorld(const G4VSolid* world);
+
+  // contained[i] is set to 1 if point i is inside the world and the acceptance envelope, 0 otherwise.
+  // Points with needed[i] == 0 are not tested and set to 0. A null needed tests all points
+  void evaluate(const double* x,
+                const double* y,
+                const double* z,
+                const unsigned char* needed,
+                std::size_t n,
+                std::vector<unsigned char>& contained) const;
+
+private:
+  enum State : unsigned char { kNotContained = 0, kContained = 1, kAmbiguous = 2 };
+
+  const G4VSolid* world_;
+  G4ThreeVector outerMin_, outerMax_;  // Bounding box of the world, grown by the surface tolerance
+  G4ThreeVector innerMin_, innerMax_;  // Box inside the world, shrunk by the surface tolerance
+  double envelopeRadius2_;             // Squared radius of the acceptance cylinder, 0 if there is none
+  double envelopeHalfLength_;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SimG4Core_CustomPhysics_RHadronDecayLibrary_H
+#define SimG4Core_CustomPhysics_RHadronDecayLibrary_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Library of precomputed R-hadron decays in the R-hadron rest frame.
+// The library is a versioned binary file keyed by a hash of the SLHA file and the Pythia8 command file.
+// It is memory-mapped read-only, so every thread can sample from it without copying it.
+//
+// File layout (all sections 8-byte aligned):
+//   Header | Species[nSpecies] (sorted by pdgId) | Decay[nDecays] | Product[nProducts]
+
+class RHadronDecayLibrary {
+public:
+  static constexpr char kMagic[8] = {'R', 'H', 'D', 'E', 'C', 'L', 'I', 'B'};
+  static constexpr uint32_t kVersion = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nSpecies;
+    uint64_t inputHash;
+    uint64_t nDecays;
+    uint64_t nProducts;
+  };
+
+  struct Species {
+    int32_t pdgId;
+    uint32_t nDecays;
+    uint64_t firstDecay;
+  };
+
+  struct Decay {
+    uint32_t firstProduct;
+    uint32_t nProducts;
+  };
+
+  // One entry of the Pythia8 event record in the rest frame of the R-hadron.
+  // Momenta in GeV, vertices (x, y, z, t) in mm and mm/c, as given by Pythia8.
+  struct Product {
+    int32_t pdgId;
+    int32_t status;
+    double p[4];
+    double vProd[4];
+    double vDec[4];
+  };
+
+  typedef std::map<int, std::vector<std::vector<Product>>> DecayMap;
+
+  RHadronDecayLibrary() = default;
+  ~RHadronDecayLibrary();
+
+  RHadronDecayLibrary(const RHadronDecayLibrary&) = delete;
+  RHadronDecayLibrary& operator=(const RHadronDecayLibrary&) = delete;
+
+  // Hash of the inputs that determine the decay distributions
+  static uint64_t inputHash(const std::string& slhaFile, const std::vector<std::string>& commands);
+
+  // Write the decays to fileName. The file is written to a temporary name and renamed, so concurrent jobs never see a partial library.
+  static bool write(const std::string& fileName, uint64_t inputHash, const DecayMap& decays);
+
+  // Map the library in memory. Returns false if the file is missing, malformed, of another version or built from other inputs.
+  bool open(const std::string& fileName, uint64_t expectedHash);
+  bool isOpen() const { return header_ != nullptr; }
+
+  bool hasSpecies(int pdgId) const { return findSpecies(pdgId) != nullptr; }
+
+  // Pick one decay of the species given a uniform random number u in [0, 1). Returns an empty range if the species is unknown.
+  std::pair<const Product*, const Product*> sample(int pdgId, double u) const;
+
+private:
+  const Species* findSpecies(int pdgId) const;
+  void close();
+
+  void* mapped_ = nullptr;
+  std::size_t mappedSize_ = 0;
+  const Header* header_ = nullptr;
+  const Species* species_ = nullptr;
+  const Decay* decays_ = nullptr;
+  const Product* products_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef SimG4Core_CustomPhysics_RHadronDecayRecordSink_H
+#define SimG4Core_CustomPhysics_RHadronDecayRecordSink_H
+
+#include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayDataManager.h"
+#include "DataFormats/Provenance/interface/EventID.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Optional stream of the R-hadron decays of the job to a compressed columnar file, for analyses that only need the
+// decay tables and not the EDM file. The decays of each event are handed over with its edm::EventID when
+// RHDecayRecordPublisher publishes the decay record of the event, and queued in a bounded queue, from which a dedicated
+// writer thread builds row groups of about eventsPerRowGroup events. Each column of a row group is compressed with zlib.
+// The file is opened when the first decayer is configured and completed by finish(), which the last
+// RHDecayRecordPublisher calls at the end of the job.
+//
+// File layout, in the byte order of the host: "RHDR", uint32 version, then row groups up to the end of the file:
+//   uint32 number of decays, uint32 number of daughters, then for each column uint32 compressed size, uint32 raw size
+//   and the compressed data.
+//   Decay columns: uint32 run, luminosityBlock; uint64 event; int32 trackID, pdgID; float64 px, py, pz, energy (MeV),
+//                  x, y, z (mm), time (ns); uint32 number of daughters.
+//   Daughter columns: int32 trackID, pdgID; float32 px, py, pz, energy (MeV), dx, dy, dz (mm), dt (ns), where the
+//                     position and time are relative to the decay vertex.
+
+class RHadronDecayRecordSink {
+public:
+  // Called by each decayer with its configuration. The first one with a file name opens the file of the job; an empty
+  // file name leaves recording disabled
+  static void configure(const std::string& fileName, unsigned int eventsPerRowGroup);
+  // Called by RHDecayRecordPublisher once the event is simulated. Copies the decays, and blocks while the queue is full
+  static void record(const edm::EventID& eventID, const RHadronPythiaDecayDataManager::DecayRecords& decays);
+  // Writes everything still queued and closes the file. Recording stays disabled afterwards
+  static void finish();
+
+  RHadronDecayRecordSink(const std::string& fileName, unsigned int eventsPerRowGroup);
+  // Writes everything still queued and closes the file
+  ~RHadronDecayRecordSink();
+
+private:
+  struct Batch {
+    edm::EventID eventID;
+    RHadronPythiaDecayDataManager::DecayRecords decays;
+  };
+
+  static constexpr std::size_t kQueueBatches = 64;  // Capacity of the queue, in events
+  static constexpr std::uint32_t kVersion = 2;
+
+  void push(const edm::EventID& eventID, const RHadronPythiaDecayDataManager::DecayRecords& decays);
+  void run();
+  void append(const Batch& batch);
+  void writeRowGroup();
+  template <typename T>
+  void writeColumn(const std::vector<T>& column);
+
+  std::string fileName_;
+  unsigned int eventsPerRowGroup_;
+  std::ofstream out_;
+
+  std::mutex mutex_;
+  std::condition_variable notEmpty_, notFull_;
+  std::deque<Batch> queue_;
+  std::vector<Batch> spare_;  // Written batches, whose buffers are reused for later events
+  bool stopping_;
+
+  // Columns of the current row group, only touched by the writer thread
+  unsigned int rowGroupEvents_;
+  std::vector<std::uint32_t> run_, luminosityBlock_;
+  std::vector<std::uint64_t> event_;
+  std::vector<std::int32_t> trackID_, pdgID_;
+  std::vector<double> px_, py_, pz_, energy_, x_, y_, z_, time_;
+  std::vector<std::uint32_t> nDaughters_;
+  std::vector<std::int32_t> dTrackID_, dPdgID_;
+  std::vector<float> dPx_, dPy_, dPz_, dEnergy_, dX_, dY_, dZ_, dT_;
+  std::vector<unsigned char> compressed_;
+
+  std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SimG4Core_CustomPhysics_RHadronDecayStats_H
+#define SimG4Core_CustomPhysics_RHadronDecayStats_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Opt-in timing and multiplicity counters of RHadronPythiaDecayer, per R-hadron PDG id.
+// Each decayer (one per Geant4 thread) fills its own accumulators without locking. They are merged into a
+// process-wide total when the decayer is destroyed, and writeReport() merges those still alive and writes the JSON
+// report once, when the last RHDecayRecordPublisher watcher is destroyed at the end of the job.
+// When no report file is configured, species() returns nullptr and every hook reduces to a null pointer check.
+
+class RHadronDecayStats {
+public:
+  enum Stage { kFillParticle, kToConstituents, kPythiaNext, kConversion, kLibrarySample, kPhaseSpace, kHadronLevel, kAsyncWait, kNStages };
+  enum Counter {
+    kDecays,               // All decays of the species
+    kLibraryDecays,        // Decays sampled from the decay library
+    kFastDecays,           // Decays through the SLHA phase space decay and Pythia8 hadronization only
+    kAsyncDecays,          // Decays computed by the asynchronous decay service
+    kProducts,             // Products handed to Geant4
+    kDroppedOutsideWorld,  // Products dropped by the world volume or acceptance envelope check
+    kUnknownPdgId,         // Products skipped because Geant4 has no definition for them
+    kNextFailures,         // Failed calls to Pythia8::Pythia::next() or forceHadronLevel()
+    kNCounters
+  };
+  static constexpr int kNBins = 40;  // Latency histogram bins: bin i counts durations in [2^i, 2^(i+1)) ns
+
+  struct Species {
+    uint64_t counters[kNCounters] = {};
+    uint64_t totalNs[kNStages] = {};
+    uint64_t histogram[kNStages][kNBins] = {};
+
+    void merge(const Species& other);
+  };
+
+  // Times a stage of the decay of one species. Does nothing for a null species
+  class Timer {
+  public:
+    Timer(Species* species, Stage stage) : species_(species), stage_(stage) {
+      if (species_)
+        start_ = std::chrono::steady_clock::now();
+    }
+    ~Timer() {
+      if (species_)
+        RHadronDecayStats::record(*species_, stage_, std::chrono::steady_clock::now() - start_);
+    }
+
+  private:
+    Species* species_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  explicit RHadronDecayStats(const std::string& reportFile);
+  ~RHadronDecayStats();
+
+  bool enabled() const { return enabled_; }
+
+  // Accumulators of a species on this thread, nullptr when disabled
+  Species* species(int pdgId) { return enabled_ ? &species_[pdgId] : nullptr; }
+
+  // Cleared accumulators for the stages of a decay path that are only kept if it succeeds, nullptr when disabled
+  Species* scratch() {
+    if (!enabled_)
+      return nullptr;
+    scratch_ = Species();
+    return &scratch_;
+  }
+
+  // Merges the accumulators of the decayers still alive and writes the report, if one is configured. Called once at
+  // the end of the job, when no decay is running
+  static void writeReport();
+
+  static void count(Species* species, Counter counter, uint64_t n = 1) {
+    if (species)
+      species->counters[counter] += n;
+  }
+
+private:
+  static void record(Species& species, Stage stage, std::chrono::steady_clock::duration duration);
+
+  bool enabled_;
+  std::unordered_map<int, Species> species_;
+  Species scratch_;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef SimG4Core_CustomPhysics_RHadronFlavourTable_H
+#define SimG4Core_CustomPhysics_RHadronFlavourTable_H
+
+#include <array>
+#include <cstddef>
+
+// Compile-time flavour decomposition of the R-hadrons that CustomParticleFactory can register.
+// Each entry gives the sparticle inside the R-hadron and the possible spectator (di)quark splittings with their
+// selection probabilities, following Pythia8::RHadrons::fromIdWithSquark and Pythia8::RHadrons::fromIdWithGluino.
+// Entries are given for particles; anti-R-hadrons use the entry of |pdgId| with charge-conjugated constituents.
+
+namespace rhadron {
+
+  struct Constituents {
+    int id1;             // Squark, or first spectator of a gluino R-hadron
+    int id2;             // Spectator (di)quark
+    double probability;  // Probability to split the R-hadron into this pair
+    double mass1;        // Pythia8 constituent mass of id1 in GeV (0 for squarks)
+    double mass2;        // Pythia8 constituent mass of id2 in GeV
+  };
+
+  struct FlavourEntry {
+    int pdgId;
+    bool isOctet;     // Gluino R-hadron
+    int sparticleId;  // Default PDG id of the sparticle: 1000021, 1000006 or 1000005
+    int nChoices;
+    Constituents choices[6];
+  };
+
+  // R-hadrons handled by Pythia8::RHadrons: sbottom and stop mesons and baryons, gluinoball, gluino mesons and baryons
+  constexpr std::array<int, 45> kRHadronIds = {
+      {1000512, 1000522, 1000532, 1000542, 1000552, 1000612, 1000622, 1000632, 1000642, 1000652, 1000993, 1005113,
+       1005211, 1005213, 1005223, 1005311, 1005313, 1005321, 1005323, 1005333, 1006113, 1006211, 1006213, 1006223,
+       1006311, 1006313, 1006321, 1006323, 1006333, 1009113, 1009213, 1009223, 1009313, 1009323, 1009333, 1091114,
+       1092114, 1092214, 1092224, 1093114, 1093214, 1093224, 1093314, 1093324, 1093334}};
+
+  namespace detail {
+    constexpr int kPowersOfTen[8] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+    // n-th decimal digit of |value|, counting from 1 for the last digit
+    constexpr int digit(int value, int n) { return ((value < 0 ? -value : value) / kPowersOfTen[n - 1]) % 10; }
+
+    // Pythia8 constituent masses of the quarks (ParticleDataEntry::CONSTITUENTMASSTABLE); diquarks sum their quarks
+    constexpr double kConstituentMass[6] = {0., 0.325, 0.325, 0.50, 1.60, 5.00};
+
+    constexpr double constituentMass(int id) {
+      const int absId = id < 0 ? -id : id;
+      if (absId < 6)
+        return kConstituentMass[absId];
+      if (absId > 1000 && absId < 10000 && digit(absId, 2) == 0)
+        return kConstituentMass[absId / 1000] + kConstituentMass[digit(absId, 3)];
+      return 0.;
+    }
+
+    constexpr bool isOctet(int pdgId) {
+      return pdgId == 1000993 || digit(pdgId, 5) == 9 || (digit(pdgId, 5) == 0 && digit(pdgId, 4) == 9);
+    }
+
+    constexpr void addChoice(FlavourEntry& entry, int id1, int id2, double probability) {
+      entry.choices[entry.nChoices] = {id1, id2, probability, constituentMass(id1), constituentMass(id2)};
+      ++entry.nChoices;
+    }
+
+    // Gluino-baryon: split into q + qq. The spin-1 diquark is taken with probability 1/2 unless both quarks are equal
+    constexpr void addBaryonChoice(FlavourEntry& entry, int quark, int qa, int qb, double probability) {
+      const int diquark = 1000 * qa + 100 * qb + 3;
+      if (qa == qb) {
+        addChoice(entry, quark, diquark, probability);
+      } else {
+        addChoice(entry, quark, diquark, 0.5 * probability);
+        addChoice(entry, quark, diquark - 2, 0.5 * probability);
+      }
+    }
+
+    constexpr FlavourEntry makeEntry(int pdgId) {
+      FlavourEntry entry{pdgId, isOctet(pdgId), 0, 0, {}};
+      const int idLight = (pdgId - 1000000) / 10;
+
+      if (!entry.isOctet) {
+        // Squark R-hadron: squark plus light (di)quark
+        const int idSq = (idLight < 100) ? idLight / 10 : idLight / 100;
+        entry.sparticleId = (idSq == 6) ? 1000006 : 1000005;
+        int id2 = (idLight < 100) ? idLight % 10 : idLight % 100;
+        if (id2 > 10)
+          id2 = 100 * id2 + pdgId % 10;
+        if (id2 < 10)
+          id2 = -id2;
+        addChoice(entry, entry.sparticleId, id2, 1.);
+        return entry;
+      }
+
+      entry.sparticleId = 1000021;
+      if (idLight < 100) {
+        // Gluinoballs: split g into d dbar or u ubar
+        addChoice(entry, 1, -1, 0.5);
+        addChoice(entry, 2, -2, 0.5);
+      } else if (idLight < 1000) {
+        // Gluino-meson: split into q + qbar, flipping signs when the first quark is of down-type
+        const int q1 = (idLight / 10) % 10;
+        const int q2 = idLight % 10;
+        if (q1 % 2 == 1)
+          addChoice(entry, q2, -q1, 1.);
+        else
+          addChoice(entry, q1, -q2, 1.);
+      } else {
+        // Gluino-baryon: pick the quark at random, except if c or b involved
+        const int idA = (idLight / 100) % 10;
+        const int idB = (idLight / 10) % 10;
+        const int idC = idLight % 10;
+        if (idA > 3) {
+          addBaryonChoice(entry, idA, idB, idC, 1.);
+        } else {
+          addBaryonChoice(entry, idA, idB, idC, 1. / 3.);
+          addBaryonChoice(entry, idB, idA, idC, 1. / 3.);
+          addBaryonChoice(entry, idC, idA, idB, 1. / 3.);
+        }
+      }
+      return entry;
+    }
+
+    constexpr std::array<FlavourEntry, kRHadronIds.size()> makeTable() {
+      std::array<FlavourEntry, kRHadronIds.size()> table{};
+      for (std::size_t i = 0; i < kRHadronIds.size(); ++i)
+        table[i] = makeEntry(kRHadronIds[i]);
+      return table;
+    }
+  }  // namespace detail
+
+  constexpr std::array<FlavourEntry, kRHadronIds.size()> kFlavourTable = detail::makeTable();
+
+  // Entry for an R-hadron or anti-R-hadron, nullptr if the PDG id is not an R-hadron known to the table
+  constexpr const FlavourEntry* findFlavourEntry(int pdgId) {
+    const int absId = pdgId < 0 ? -pdgId : pdgId;
+    std::size_t low = 0;
+    std::size_t high = kFlavourTable.size();
+    while (low < high) {
+      const std::size_t mid = (low + high) / 2;
+      if (kFlavourTable[mid].pdgId < absId)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return (low < kFlavourTable.size() && kFlavourTable[low].pdgId == absId) ? &kFlavourTable[low] : nullptr;
+  }
+
+  // Constituents of an anti-R-hadron from those of the R-hadron
+  constexpr Constituents conjugate(const Constituents& constituents, bool isOctet) {
+    return isOctet ? Constituents{-constituents.id2,
+                                  -constituents.id1,
+                                  constituents.probability,
+                                  constituents.mass2,
+                                  constituents.mass1}
+                   : Constituents{-constituents.id1,
+                                  -constituents.id2,
+                                  constituents.probability,
+                                  constituents.mass1,
+                                  constituents.mass2};
+  }
+
+  // Pick a splitting given a uniform random number u in [0, 1)
+  constexpr const Constituents& selectConstituents(const FlavourEntry& entry, double u) {
+    int i = 0;
+    for (; i < entry.nChoices - 1; ++i) {
+      u -= entry.choices[i].probability;
+      if (u < 0.)
+        break;
+    }
+    return entry.choices[i];
+  }
+
+  // Check at compile time that the ids are sorted for findFlavourEntry and that the probabilities are normalized
+  namespace detail {
+    constexpr bool isValid() {
+      for (std::size_t i = 0; i < kFlavourTable.size(); ++i) {
+        if (i > 0 && kFlavourTable[i - 1].pdgId >= kFlavourTable[i].pdgId)
+          return false;
+        double sum = 0.;
+        for (int j = 0; j < kFlavourTable[i].nChoices; ++j)
+          sum += kFlavourTable[i].choices[j].probability;
+        if (sum < 1. - 1e-9 || sum > 1. + 1e-9)
+          return false;
+      }
+      return true;
+    }
+  }  // namespace detail
+  static_assert(detail::isValid(), "R-hadron flavour table must be sorted by PDG id and normalized");
+
+}  // namespace rhadron
+
+#endif
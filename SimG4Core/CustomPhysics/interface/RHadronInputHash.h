@@ -0,0 +1,47 @@
+#ifndef SimG4Core_CustomPhysics_RHadronInputHash_H
+#define SimG4Core_CustomPhysics_RHadronInputHash_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Content hash (64-bit FNV-1a) of the inputs that determine the R-hadron decays: the SLHA file and the Pythia8 commands.
+// Used to key the files cached between jobs by RHadronDecayLibrary and RHadronPythiaInitCache.
+
+namespace rhadron {
+
+  constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+  constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+  inline uint64_t fnv1a(uint64_t hash, const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= kFnvPrime;
+    }
+    return hash;
+  }
+
+  // The salt separates the keys of different cache formats built from the same inputs
+  inline uint64_t inputHash(uint64_t salt, const std::string& slhaFile, const std::vector<std::string>& commands) {
+    uint64_t hash = fnv1a(kFnvOffset, &salt, sizeof(salt));
+
+    // Hash the content of the SLHA file rather than its path, so that relocated copies share a cache
+    if (!slhaFile.empty()) {
+      std::ifstream slhaStream(slhaFile, std::ios::binary);
+      const std::string content((std::istreambuf_iterator<char>(slhaStream)), std::istreambuf_iterator<char>());
+      hash = fnv1a(hash, content.data(), content.size());
+    }
+    for (const auto& command : commands) {
+      hash = fnv1a(hash, command.data(), command.size());
+      hash = fnv1a(hash, "\n", 1);
+    }
+    return hash;
+  }
+
+}  // namespace rhadron
+
+#endif
@@ -1,11 +1,22 @@
 #ifndef RHadronPythiaDecayDataManager_H
 #define RHadronPythiaDecayDataManager_H
 
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "G4Track.hh"
+#include "G4Threading.hh"
+#include "DataFormats/Provenance/interface/EventID.h"
 
-// Class to manage storage of R-hadron decay information between RHadronPythiaDecayer and RHDecayTracer
+// Class to manage storage of R-hadron decay information between RHadronPythiaDecayer and RHDecayTracer.
+// Each Geant4 thread appends its decays to its own record for the event it is simulating, so recording a decay takes
+// no lock. The Geant4 event ID is only the event number, so RHDecayRecordPublisher, a watcher of g4SimHits, opens the
+// record at the beginning of each Geant4 event and publishes it under the full edm::EventID once the event is simulated.
+// RHDecayTracer then takes the record of its own event. A published record that RHDecayTracer did not take is dropped
+// when the stream begins its next event; without the watcher, a thread only keeps the record of its current event.
 
 class RHadronPythiaDecayDataManager {
 public:
@@ -17,54 +28,112 @@ public:
         
         // Constructor to extract data from G4Track. Necessary to avoid storing G4Track pointers that may become invalid.
         TrackData() : trackID(0), pdgID(0), px(0), py(0), pz(0), energy(0), x(0), y(0), z(0), time(0) {} // Default constructor
-        TrackData(const G4Track& track) 
-            : trackID(track.GetTrackID()),
-              pdgID(track.GetDefinition()->GetPDGEncoding()),
-              px(track.GetMomentum().x()),
-              py(track.GetMomentum().y()),
-              pz(track.GetMomentum().z()),
-              energy(track.GetTotalEnergy()),
-              x(track.GetPosition().x()),
-              y(track.GetPosition().y()),
-              z(track.GetPosition().z()),
-              time(track.GetGlobalTime()) {}
+        TrackData(const G4Track& track) : trackID(track.GetTrackID()), pdgID(track.GetDefinition()->GetPDGEncoding()) {
+            // G4Track::GetMomentum builds the vector from the dynamic particle on every call
+            const G4ThreeVector momentum = track.GetMomentum();
+            const G4ThreeVector& position = track.GetPosition();
+            px = momentum.x();
+            py = momentum.y();
+            pz = momentum.z();
+            energy = track.GetTotalEnergy();
+            x = position.x();
+            y = position.y();
+            z = position.z();
+            time = track.GetGlobalTime();
+        }
+    };
+
+    // Daughter stored in 40 instead of 72 bytes: momentum and energy as float, position and time as float offsets from
+    // the decay vertex of the parent, and the PDG code as an index into the PDG codes of the DecayRecords.
+    // The round trip keeps a relative precision of 2^-24 on the momentum and energy and on the offsets, i.e. better
+    // than 1 um for daughters produced within 10 m of the decay vertex.
+    struct PackedDaughter {
+        int trackID;
+        std::uint16_t pdgIndex;
+        float px, py, pz, energy;
+        float dx, dy, dz, dt;
+    };
+
+    // Decays of one event in CSR layout: the daughters of parents[i] are daughters[daughtersBegin(i)] up to
+    // daughters[daughtersEnd(i)]. Clearing keeps the capacity
+    struct DecayRecords {
+        std::vector<TrackData> parents;
+        std::vector<PackedDaughter> daughters;
+        std::vector<std::size_t> daughterOffsets;
+        std::vector<int> pdgCodes; // PDG codes of the daughters, indexed by PackedDaughter::pdgIndex
+
+        std::size_t size() const { return parents.size(); }
+        bool empty() const { return parents.empty(); }
+        std::size_t daughtersBegin(std::size_t i) const { return daughterOffsets[i]; }
+        std::size_t daughtersEnd(std::size_t i) const {
+            return i + 1 < daughterOffsets.size() ? daughterOffsets[i + 1] : daughters.size();
+        }
+        void clear() {
+            parents.clear();
+            daughters.clear();
+            daughterOffsets.clear();
+            pdgCodes.clear();
+        }
+
+        void addParent(const G4Track& track) {
+            parents.emplace_back(track);
+            daughterOffsets.push_back(daughters.size());
+        }
+        // Appends a daughter of the last parent
+        void addDaughter(const G4Track& track);
+        // Daughter j of parent i, decoded
+        TrackData daughter(std::size_t i, std::size_t j) const;
+
+    private:
+        std::uint16_t pdgIndex(int pdgCode);
     };
 
     static RHadronPythiaDecayDataManager& getInstance() {
         static RHadronPythiaDecayDataManager instance;
         return instance;
     }
-    
-    void addDecayParent(const G4Track& aTrack) {
-        std::lock_guard<std::mutex> lock(dataMutex_);
-        decayCounter_++;
-        storedDecayParents_[decayCounter_] = TrackData(aTrack);
-    }
 
-    void addDecayDaughter(const G4Track& aTrack) {
-        std::lock_guard<std::mutex> lock(dataMutex_);
-        storedDecayDaughters_[decayCounter_].emplace_back(aTrack);
-    }
+    // Decays recorded by one thread during one Geant4 event
+    struct EventRecord {
+        explicit EventRecord(int id) : g4EventID(id) {}
+        const int g4EventID;
+        edm::EventID eventID; // Set on publication, under registryMutex_
+        DecayRecords decays;
+    };
 
-    void getDecayInfo(std::map<int, TrackData>& decayParents, std::map<int, std::vector<TrackData>>& decayDaughters) {
-        std::lock_guard<std::mutex> lock(dataMutex_);
-        decayParents = storedDecayParents_;
-        decayDaughters = storedDecayDaughters_;
-    }
+    // Called by RHadronPythiaDecayer on the Geant4 thread. The daughters belong to the last parent added by the same thread
+    void addDecayParent(const G4Track& aTrack);
+    void addDecayDaughter(const G4Track& aTrack);
 
-    void clearDecayInfo() {
-        std::lock_guard<std::mutex> lock(dataMutex_);
-        decayCounter_ = 0;
-        storedDecayParents_.clear();
-        storedDecayDaughters_.clear();
-    }
+    // Called by RHDecayRecordPublisher. beginEvent opens the record of the current Geant4 event on the calling thread,
+    // publish makes it available to RHDecayTracer once the event is simulated, and drop discards it if it was published
+    // but never collected
+    std::shared_ptr<EventRecord> beginEvent();
+    void publish(const std::shared_ptr<EventRecord>& record, const edm::EventID& eventID);
+    void drop(const std::shared_ptr<EventRecord>& record);
+
+    // Called by RHDecayRecordPublisher on construction and destruction. unregisterPublisher returns true for the last one
+    void registerPublisher();
+    bool unregisterPublisher();
+    // True once a publisher was constructed in this job. Without one no record is ever published
+    bool hasPublisher() const { return publisherRegistered_.load(std::memory_order_acquire); }
+
+    // Called by RHDecayTracer. Swaps the decays of the given event into decays, whose previous content is discarded
+    void getDecayInfo(const edm::EventID& eventID, DecayRecords& decays);
 
 private:
-    RHadronPythiaDecayDataManager() {}
-    std::mutex dataMutex_;
-    int decayCounter_ = 0;
-    std::map<int, TrackData> storedDecayParents_;
-    std::map<int, std::vector<TrackData>> storedDecayDaughters_;
+    RHadronPythiaDecayDataManager() : publishers_(0), publisherRegistered_(false) {}
+    EventRecord& recordForCurrentEvent();
+    // Hands the buffers of a record that is no longer reachable back for reuse. Needs registryMutex_
+    void recycle(EventRecord& record);
+
+    // Only taken when a thread opens the record for a new event, on publication and by the consumer, never per decay
+    std::mutex registryMutex_;
+    std::vector<std::shared_ptr<EventRecord>> records_; // Published records
+    std::vector<DecayRecords> spareDecays_;
+    std::atomic<int> publishers_;
+    std::atomic<bool> publisherRegistered_;
+    static G4ThreadLocal std::shared_ptr<EventRecord> currentRecord_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,13 +2,19 @@
 #define RHadronPythiaDecayer_H
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronAsyncDecayService.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayBuffer.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayContainment.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayStats.h"
 #include "G4Decay.hh"
 #include "G4VExtDecayer.hh"
 #include "G4ThreeVector.hh"
+#include "G4Threading.hh"
 #include <string>
 #include <vector>
 #include <utility>
 #include <memory>
+#include <future>
 
 
 namespace gen {
@@ -20,8 +26,11 @@ namespace Pythia8 {
   class Pythia;
   class Event;
   class Rndm;
+  class Vec4;
 }
 
+class RHadronPythiaInitCache;
+
 class G4DynamicParticle;
 class G4DecayProducts;
 class G4VParticleChange;
@@ -36,18 +45,60 @@ class RHadronPythiaDecayer: public G4Decay, public G4VExtDecayer
    G4VParticleChange* DecayIt(const G4Track& aTrack, const G4Step& aStep) override; //What Geant calls to decay the Rhadron
    virtual G4DecayProducts* ImportDecayProducts(const G4Track&); //Tell pythia to decay the Rhadron and return the products in Geant format
 
+   void StartTracking(G4Track* aTrack) override; //Request the decay at rest from the asynchronous decay service, if it is enabled
+   void EndTracking() override; //Cancel the requested decay of an R-hadron that did not decay
+
+   void buildDecayLibrary(const std::vector<int>& pdgIds); //Pre-generate rest-frame decays of the given R-hadrons into the decay library file, if one is configured and it is missing or stale
+
   private:
-   void RHadronToConstituents(Pythia8::Event& event); // Strip the RHadron down to its constituents in preperation for decaying the gluino or squark
+   // RHadrons:idGluino, RHadrons:idStop and RHadrons:idSbottom of the initialized pythia instances
+   struct SparticleIds {
+     int gluino, stop, sbottom;
+   };
 
-   std::pair<int,int> fromIdWithSquark( int idRHad) const;
-   std::pair<int,int> fromIdWithGluino( int idRHad, Pythia8::Rndm* rndmPtr) const;
+   static void RHadronToConstituents(Pythia8::Pythia& pythia, const SparticleIds& ids); // Strip the RHadron down to its constituents in preperation for decaying the gluino or squark
 
-   bool isGluinoRHadron(int pdgId) const;
    void fillParticle(const G4Track&, Pythia8::Event& event) const; //Fill a Pythia8 event with the information from a G4Track
-   void pythiaDecay(const G4Track&, std::vector<G4DynamicParticle*> &); //Function to decay the RHadron and return products in G4 format
+   static void fillParticle(int pdgId, double mass, const Pythia8::Vec4& p4, Pythia8::Event& event); //Fill a Pythia8 event with a single R-hadron (GeV)
+   void prepareContainment(); // Cache the world solid for the containment test on first use
+   void pythiaDecay(const G4Track&, G4DecayProducts&); //Function to decay the RHadron and add the products in G4 format
+   bool fastDecay(const G4Track&, G4DecayProducts&); //Decay the sparticle with the SLHA decay table through phase space and only hadronize with pythia. Returns false if the decay is left to pythiaDecay
+   void convertEvent(const G4Track&, Pythia8::Event&, G4DecayProducts&, RHadronDecayStats::Species*); //Add the final particles of the decay in the world volume to the G4 decay products
+   void addBufferedProducts(const G4Track&, const G4ThreeVector& beta, G4DecayProducts&, RHadronDecayStats::Species*); //Boost the products in decayBuffer_ to the lab frame and add those in the world volume to the G4 decay products
+   bool libraryDecay(const G4Track&, G4DecayProducts&); //Sample a decay from the library and boost it to the lab frame. Returns false if the R-hadron is not in the library
+   static int requestSeed(const G4Track&); //Seed of the decay requested for a track, without drawing from the random engine of the stream
+   bool asyncDecay(const G4Track&, G4DecayProducts&); //Collect the decay requested at the start of the track and boost it to the lab frame. Returns false if there is none
+   void convertRestFrameDecay(const G4Track&, const RHadronDecayLibrary::Product* first, const RHadronDecayLibrary::Product* last, G4DecayProducts&, RHadronDecayStats::Species*); //Boost a decay at rest to the R-hadron and add the products in the world volume to the G4 decay products
+   static bool restFrameDecay(Pythia8::Pythia& pythia, const SparticleIds& ids, int pdgId, double mass, std::vector<RHadronDecayLibrary::Product>& products); //Decay an R-hadron at rest, keeping final particles and displaced decayed particles. Only touches the given instance, so it runs on the helper threads
+
+   Pythia8::Pythia* pythia(); // Thread-local pythia instance, created on first use and attached to the random engine of the current stream
+   std::unique_ptr<Pythia8::Pythia> createPythia(const std::vector<std::string>& extraCommands, const gen::P8RndmEnginePtr& rndmEngine); // Initialized pythia instance, restored from the init snapshot when there is one
+   void initPythia(Pythia8::Pythia& pythia); // Apply the SLHA file and command file settings, initialize pythia and cache the R-hadron settings
+   void readRHadronSettings(const Pythia8::Pythia& pythia); // Cache the R-hadron settings of an initialized pythia
+
+   std::string slhaFile_; // SLHA particle definitions file given to pythia
+   std::vector<std::string> pythiaCommands_; // Pythia8 settings, read once from the command file at construction
+   std::string initCacheFile_; // Binary cache of the initialized pythia state shared between jobs. Empty to only share it between the threads of a job
+   std::string libraryFile_; // Rest-frame decay library. Empty to always run pythia
+   unsigned int libraryDecaysPerSpecies_; // Number of decays generated per R-hadron species when building the library
+   std::unique_ptr<RHadronDecayLibrary> library_; // Opened on first use on each thread
+   bool libraryUnavailable_; // Set when the library could not be opened, to fall back to pythia without retrying
+   unsigned int asyncDecayThreads_; // Helper threads of the asynchronous decay service. 0 to decay synchronously
+   std::unique_ptr<RHadronAsyncDecayService> asyncService_; // Created on the first R-hadron track
+   RHadronAsyncDecayService::Ticket pendingDecay_; // Decay requested for the R-hadron currently tracked
+   int pendingPdgId_;
+   std::vector<int> fastDecayIds_; // Sorted |PDG ids| of the R-hadrons decayed by fastDecay
+   RHadronDecayContainment containment_; // Containment of the decay products in the world and in the optional acceptance envelope
+   RHadronDecayBuffer decayBuffer_; // Products of the current decay
+   std::vector<unsigned char> prodContained_, decContained_; // Containment of their production and decay vertices
+   RHadronDecayStats stats_; // Per-species timing and multiplicity counters, enabled by RhadronDecayTimingReportFile
+   std::vector<G4ThreeVector> secondaryDisplacements_; // Cleared on every decay, keeping its capacity
+   SparticleIds sparticleIds_; // Read once after initialization. The helper threads get their own copy
 
-   std::unique_ptr<Pythia8::Pythia> pythia_; // Instance of pythia
-   std::vector<G4ThreeVector> secondaryDisplacements_;
+   static G4ThreadLocal std::unique_ptr<Pythia8::Pythia> pythia_; // One instance of pythia per Geant4 worker thread
+   static G4ThreadLocal gen::P8RndmEnginePtr p8RndmEngine_; // Pythia random engine forwarding to the CMSSW engine of the stream
+   static std::unique_ptr<RHadronPythiaInitCache> initCache_; // Snapshot of the first initialized pythia, restored by all later instances
+   static G4Mutex initCacheMutex_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef SimG4Core_CustomPhysics_RHadronPythiaInitCache_H
+#define SimG4Core_CustomPhysics_RHadronPythiaInitCache_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Pythia8 {
+  class Pythia;
+}
+
+// Snapshot of the Settings and ParticleData of an initialized Pythia8 instance used by RHadronPythiaDecayer.
+// Restoring from the snapshot skips the parsing of the Pythia8 XML databases and of the SLHA file.
+// The snapshot is kept in memory for the threads of a job and, optionally, in a binary cache file for later jobs,
+// keyed by a hash of the SLHA file, the Pythia8 commands and the Pythia8 version.
+//
+// File layout: Header | settings XML | particle data XML
+
+class RHadronPythiaInitCache {
+public:
+  static constexpr char kMagic[8] = {'R', 'H', 'P', 'Y', 'I', 'N', 'I', 'T'};
+  static constexpr uint32_t kVersion = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t pythiaVersion;
+    uint64_t inputHash;
+    uint64_t settingsSize;
+    uint64_t particleDataSize;
+  };
+
+  RHadronPythiaInitCache(const std::string& fileName, const std::string& slhaFile, const std::vector<std::string>& commands);
+
+  bool isLoaded() const { return loaded_; }
+
+  // Read the snapshot from the cache file. Returns false if there is no file or it was built from other inputs
+  bool load();
+
+  // Take the snapshot from an initialized instance and write it to the cache file, if there is one
+  void capture(Pythia8::Pythia& pythia);
+
+  // A new, not yet initialized, instance built from the snapshot.
+  // It does not read the SLHA file again nor repeat the listings already printed when the snapshot was taken.
+  std::unique_ptr<Pythia8::Pythia> restore() const;
+
+private:
+  bool save() const;
+
+  std::string fileName_;
+  uint64_t inputHash_;
+  bool loaded_;
+  std::string settingsXML_;
+  std::string particleDataXML_;
+};
+
+#endif
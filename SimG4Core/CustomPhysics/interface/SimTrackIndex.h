@@ -0,0 +1,40 @@
+#ifndef SimG4Core_CustomPhysics_SimTrackIndex_H
+#define SimG4Core_CustomPhysics_SimTrackIndex_H
+
+#include "SimDataFormats/Track/interface/SimTrackContainer.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Geant4 track ID -> SimTrack lookup for the SimTrack collection of one event, built once per event in a single pass.
+// Track IDs are dense in practice, so the index is a flat array from track ID to position in the collection; if the
+// IDs turn out to be sparse it falls back to a hash map. The storage is kept between events.
+// The index refers to the collection it was built from, which must stay alive while find() is used.
+
+class SimTrackIndex {
+public:
+  SimTrackIndex() : tracks_(nullptr) {}
+
+  void build(const edm::SimTrackContainer& tracks);
+
+  // nullptr if no SimTrack has this track ID
+  const SimTrack* find(unsigned int trackID) const {
+    if (dense_.empty()) {
+      const auto it = sparse_.find(trackID);
+      return it != sparse_.end() ? &(*tracks_)[it->second] : nullptr;
+    }
+    if (trackID >= dense_.size() || dense_[trackID] == kMissing)
+      return nullptr;
+    return &(*tracks_)[dense_[trackID]];
+  }
+
+private:
+  static constexpr std::uint32_t kMissing = ~std::uint32_t(0);
+
+  const edm::SimTrackContainer* tracks_;
+  std::vector<std::uint32_t> dense_;
+  std::unordered_map<unsigned int, std::uint32_t> sparse_;
+};
+
+#endif
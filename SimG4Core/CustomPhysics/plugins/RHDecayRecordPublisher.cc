@@ -0,0 +1,36 @@
+#include "SimG4Core/CustomPhysics/interface/RHDecayRecordPublisher.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayRecordSink.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayStats.h"
+#include "FWCore/Framework/interface/Event.h"
+
+RHDecayRecordPublisher::RHDecayRecordPublisher(edm::ParameterSet const&) {
+  // One instance per stream, called on the Geant4 thread of that stream
+  setMT(true);
+  RHadronPythiaDecayDataManager::getInstance().registerPublisher();
+}
+
+RHDecayRecordPublisher::~RHDecayRecordPublisher() {
+  // The watchers are destroyed with the Geant4 workers at the end of the job; the last one completes the outputs
+  if (RHadronPythiaDecayDataManager::getInstance().unregisterPublisher()) {
+    RHadronDecayStats::writeReport();
+    RHadronDecayRecordSink::finish();
+  }
+}
+
+void RHDecayRecordPublisher::update(const BeginOfEvent*) {
+  RHadronPythiaDecayDataManager& manager = RHadronPythiaDecayDataManager::getInstance();
+  // The stream finished its previous event, so RHDecayTracer has taken that record if it is scheduled
+  if (published_)
+    manager.drop(published_);
+  published_.reset();
+  record_ = manager.beginEvent();
+}
+
+void RHDecayRecordPublisher::produce(edm::Event& iEvent, const edm::EventSetup&) {
+  if (!record_)
+    return;
+  // The record is copied to the decay record file before RHDecayTracer can take its decays
+  RHadronDecayRecordSink::record(iEvent.id(), record_->decays);
+  RHadronPythiaDecayDataManager::getInstance().publish(record_, iEvent.id());
+  published_ = std::move(record_);
+}
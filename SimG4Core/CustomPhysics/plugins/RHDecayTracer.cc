@@ -4,72 +4,108 @@
 #include "HepMC/GenEvent.h"
 #include "HepMC/GenVertex.h"
 #include "HepMC/GenParticle.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
 
-// Producer that adds R-hadron decay information from RHadronPythiaDecayer to the HepMC event
+#include <atomic>
+
+// Producer that collects the R-hadron decays of RHadronPythiaDecayer and optionally adds them to a copy of the HepMC event
 using TrackData = RHadronPythiaDecayDataManager::TrackData;
 
+namespace {
+  // The missing watcher is reported by the first stream that notices it
+  std::atomic<bool> missingPublisherReported(false);
+}
+
 RHDecayTracer::RHDecayTracer(edm::ParameterSet const& p)
-    : edm::one::EDProducer<edm::one::SharedResources>() 
+    : mergeIntoHepMC_(p.getUntrackedParameter<bool>("mergeIntoHepMC", false))
 {
-  genToken_      = consumes<edm::HepMCProduct>(edm::InputTag("generatorSmeared"));
   simTrackToken_ = consumes<edm::SimTrackContainer>(edm::InputTag("g4SimHits"));
+  produces<RHadronDecayCollection>();
+  if (mergeIntoHepMC_) {
+    genToken_ = consumes<edm::HepMCProduct>(edm::InputTag("generatorSmeared"));
+    produces<edm::HepMCProduct>();
+  }
 }
 
 void RHDecayTracer::produce(edm::Event& iEvent, const edm::EventSetup&) {
-  // Get track data from RHadronPythiaDecayDataManager
-  std::map<int, TrackData> decayParents;
-  std::map<int, std::vector<TrackData>> decayDaughters;
-  RHadronPythiaDecayDataManager::getInstance().getDecayInfo(decayParents, decayDaughters);
-
-  // If no decays were recorded, skip the producer
-  if (decayParents.empty()) return;
-
-  // Get the HepMC event and SimTrack collection
-  iEvent.getByToken(genToken_, genHandle_);
-  iEvent.getByToken(simTrackToken_, simTrackHandle_);
-  HepMC::GenEvent* mcEvent = const_cast<HepMC::GenEvent*>(genHandle_->GetEvent());
-
-  // Loop over each decay parent and create a HepMC vertex with its daughters
-  for (const auto& parentEntry : decayParents) {
-    const int decayID = parentEntry.first;
-    const TrackData& parentData = parentEntry.second;
-    
-    // Get the SimTrack associated with the parent
-    const SimTrack* parentSimTrack = findSimTrack(parentData.trackID, *simTrackHandle_);
-    if (!parentSimTrack) continue; // Skip if SimTrack not found
+  // Get the track data of this event from RHadronPythiaDecayDataManager, published by RHDecayRecordPublisher.
+  // g4SimHits, and so its watchers, are constructed by the time it has produced the SimTracks of the first event
+  RHadronPythiaDecayDataManager& manager = RHadronPythiaDecayDataManager::getInstance();
+  if (!manager.hasPublisher() && !missingPublisherReported.exchange(true)) {
+    edm::LogWarning("SimG4CoreCustomPhysics")
+        << "RHDecayTracer: No RHDecayRecordPublisher watcher is configured in g4SimHits.Watchers, so no R-hadron decay "
+           "is handed over and every RHadronDecayCollection is empty. Add it as the customise of Exotica_HSCP_SIM_cfi does.";
+  }
+  manager.getDecayInfo(iEvent.id(), decays_);
 
-    // Get the corresponding HepMC GenParticle of the parent
-    HepMC::GenParticle* parentGenParticle = mcEvent->barcode_to_particle(parentSimTrack->genpartIndex());
+  auto decayCollection = std::make_unique<RHadronDecayCollection>();
+  decayCollection->decays.reserve(decays_.size());
+  decayCollection->daughters.reserve(decays_.daughters.size());
+  if (!decays_.empty()) {
+    const edm::SimTrackContainer& simTracks = iEvent.get(simTrackToken_);
+    simTrackIndex_.build(simTracks);
+  }
 
-    // Create a new HepMC vertex for the decay and asign the parent particle
-    HepMC::GenVertex* decayVertex = new HepMC::GenVertex(HepMC::FourVector(parentData.x, parentData.y, parentData.z, parentData.time));
-    decayVertex->add_particle_in(parentGenParticle);
+  for (std::size_t decayID = 0; decayID < decays_.size(); ++decayID) {
+    const TrackData& parentData = decays_.parents[decayID];
+    RHadronDecay decay;
+    decay.trackID = parentData.trackID;
+    decay.pdgID = parentData.pdgID;
+    decay.x = parentData.x;
+    decay.y = parentData.y;
+    decay.z = parentData.z;
+    decay.time = parentData.time;
 
-    // Add daughter particles to the vertex
-    addSecondariesToGenVertex(decayDaughters, decayID, decayVertex);
+    // Get the GenParticle of the parent through its SimTrack, if it has one
+    const SimTrack* parentSimTrack = simTrackIndex_.find(parentData.trackID);
+    if (parentSimTrack) decay.genParticleIndex = parentSimTrack->genpartIndex();
 
-    // Mark the parent as decayed and add the vertex to the event
-    parentGenParticle->set_status(2);
-    mcEvent->add_vertex(decayVertex);
+    decay.firstDaughter = decayCollection->daughters.size();
+    for (std::size_t i = decays_.daughtersBegin(decayID); i != decays_.daughtersEnd(decayID); ++i) {
+      const TrackData daughterData = decays_.daughter(decayID, i);
+      RHadronDecayDaughter daughter;
+      daughter.trackID = daughterData.trackID;
+      daughter.pdgID = daughterData.pdgID;
+      daughter.px = daughterData.px;
+      daughter.py = daughterData.py;
+      daughter.pz = daughterData.pz;
+      daughter.energy = daughterData.energy;
+      decayCollection->daughters.push_back(daughter);
+    }
+    decay.lastDaughter = decayCollection->daughters.size();
+    decayCollection->decays.push_back(decay);
   }
 
-  // Clear data for the next event
-  RHadronPythiaDecayDataManager::getInstance().clearDecayInfo();
+  if (mergeIntoHepMC_) {
+    // Copy the HepMC event, so the product of the generator step stays untouched
+    const edm::HepMCProduct& genProduct = iEvent.get(genToken_);
+    auto mcEvent = std::make_unique<HepMC::GenEvent>(*genProduct.GetEvent());
+    addDecaysToGenEvent(*decayCollection, *mcEvent);
+    iEvent.put(std::make_unique<edm::HepMCProduct>(mcEvent.release()));
+  }
+  iEvent.put(std::move(decayCollection));
 }
 
 
-const SimTrack* RHDecayTracer::findSimTrack(int trackID, const edm::SimTrackContainer& simTrackContainer) {
-    for (const auto& simTrack : simTrackContainer) {
-        if (simTrack.trackId() == static_cast<unsigned int>(trackID)) return &simTrack;
-    }
-    return nullptr;
-}
+void RHDecayTracer::addDecaysToGenEvent(const RHadronDecayCollection& decays, HepMC::GenEvent& mcEvent) const {
+  // Create a HepMC vertex for each decay of a parent with a GenParticle
+  for (const RHadronDecay& decay : decays.decays) {
+    HepMC::GenParticle* parentGenParticle = decay.genParticleIndex >= 0 ? mcEvent.barcode_to_particle(decay.genParticleIndex) : nullptr;
+    if (!parentGenParticle) continue; // Skip if the parent does not come from the generator
 
+    // Create a new HepMC vertex for the decay and asign the parent particle
+    HepMC::GenVertex* decayVertex = new HepMC::GenVertex(HepMC::FourVector(decay.x, decay.y, decay.z, decay.time));
+    decayVertex->add_particle_in(parentGenParticle);
 
-void RHDecayTracer::addSecondariesToGenVertex(std::map<int, std::vector<TrackData>> decayDaughters, const int decayID, HepMC::GenVertex* decayVertex) {
-  const auto& daughtersData = decayDaughters[decayID];
-  for (const auto& daughterData : daughtersData) {
+    // Add daughter particles to the vertex
+    for (unsigned int i = decay.firstDaughter; i != decay.lastDaughter; ++i) {
+      const RHadronDecayDaughter& daughterData = decays.daughters[i];
       HepMC::GenParticle* daughter = new HepMC::GenParticle(HepMC::FourVector(1000.0 * daughterData.px, 1000.0 * daughterData.py, 1000.0 * daughterData.pz, 1000.0 * daughterData.energy), daughterData.pdgID, 1);
       decayVertex->add_particle_out(daughter);
+    }
+
+    // Mark the parent as decayed and add the vertex to the event
+    parentGenParticle->set_status(2);
+    mcEvent.add_vertex(decayVertex);
   }
-}
\ No newline at end of file
+}
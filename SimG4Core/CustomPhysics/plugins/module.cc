@@ -5,6 +5,7 @@
 #include "SimG4Core/Physics/interface/PhysicsListFactory.h"
 #include "SimG4Core/CustomPhysics/interface/CustomPhysics.h"
 
+#include "SimG4Core/CustomPhysics/interface/RHDecayRecordPublisher.h"
 #include "SimG4Core/CustomPhysics/interface/RHDecayTracer.h"
 #include "SimG4Core/CustomPhysics/interface/RHStopDump.h"
 #include "SimG4Core/CustomPhysics/interface/RHStopTracer.h"
@@ -12,4 +13,5 @@
 DEFINE_PHYSICSLIST(CustomPhysics);
 DEFINE_FWK_MODULE(RHDecayTracer);
 DEFINE_FWK_MODULE(RHStopDump);
-DEFINE_SIMWATCHER(RHStopTracer);
\ No newline at end of file
+DEFINE_SIMWATCHER(RHStopTracer);
+DEFINE_SIMWATCHER(RHDecayRecordPublisher);
\ No newline at end of file
@@ -22,6 +22,53 @@ def customise(process):
     except:
         pass
 
+    # Caching the initialized Rhadron decayer between jobs is optional. The cache is written by the first job using it
+    try:
+        process.customPhysicsSetup.RhadronPythiaInitCacheFile = cms.untracked.string(process.generator.RhadronPythiaInitCacheFile.value())
+    except:
+        pass
+
+    # Dropping Rhadron decay products outside of an acceptance cylinder (r, half-length in mm) is optional
+    try:
+        process.customPhysicsSetup.RhadronDecayAcceptanceRadius = cms.untracked.double(process.generator.RhadronDecayAcceptanceRadius.value())
+        process.customPhysicsSetup.RhadronDecayAcceptanceHalfLength = cms.untracked.double(process.generator.RhadronDecayAcceptanceHalfLength.value())
+    except:
+        pass
+
+    # Writing a JSON report of the Rhadron decay timing and product multiplicities is optional
+    try:
+        process.customPhysicsSetup.RhadronDecayTimingReportFile = cms.untracked.string(process.generator.RhadronDecayTimingReportFile.value())
+    except:
+        pass
+
+    # Decaying selected Rhadrons with the SLHA branching ratios through phase space, and only hadronizing with pythia, is optional
+    try:
+        process.customPhysicsSetup.RhadronFastDecayPdgIds = cms.untracked.vint32(process.generator.RhadronFastDecayPdgIds.value())
+    except:
+        pass
+
+    # Decaying Rhadrons on helper threads while they are transported is optional
+    try:
+        process.customPhysicsSetup.RhadronAsyncDecayThreads = cms.untracked.uint32(process.generator.RhadronAsyncDecayThreads.value())
+    except:
+        pass
+
+    # Streaming the Rhadron decays to a compressed columnar file is optional
+    try:
+        process.customPhysicsSetup.RhadronDecayRecordFile = cms.untracked.string(process.generator.RhadronDecayRecordFile.value())
+    except:
+        pass
+    try:
+        process.customPhysicsSetup.RhadronDecayRecordEventsPerRowGroup = cms.untracked.uint32(process.generator.RhadronDecayRecordEventsPerRowGroup.value())
+    except:
+        pass
+
+    # Sampling Rhadron decays from a precomputed rest-frame decay library is optional. The library is built on first use
+    try:
+        process.customPhysicsSetup.RhadronDecayLibraryFile = cms.untracked.string(process.generator.RhadronDecayLibraryFile.value())
+    except:
+        pass
+
     if hasattr(process,'g4SimHits'):
         # defined watches
         process.g4SimHits.Watchers = cms.VPSet (
@@ -32,6 +79,11 @@ def customise(process):
                 traceParticle = cms.string ("((anti_)?~|tau1).*"), #this one regular expression is needed to look for ~HIP*, anti_~HIP*, ~tau1, anti_~tau1, ~g_rho0, ~g_Deltabar0, ~T_uu1++, etc
                 stopRegularParticles = cms.untracked.bool (False)
                 )        
+            ),
+            # Hands the R-hadron decays of each event over to RHDecayTracer, which needs it
+            cms.PSet(
+                type = cms.string('RHDecayRecordPublisher'),
+                RHDecayRecordPublisher = cms.PSet()
             )
         )
         # defined custom Physics List
@@ -55,7 +107,11 @@ def customise(process):
         )	
 
         # Add Rhadron decay tracking
-        process.RHDecayTracer = cms.EDProducer("RHDecayTracer")
+        # The decays are produced as an RHadronDecayCollection. Set mergeIntoHepMC to also get a copy of the
+        # generatorSmeared HepMC event with the decay vertices added
+        process.RHDecayTracer = cms.EDProducer("RHDecayTracer",
+            mergeIntoHepMC = cms.untracked.bool(False)
+        )
         process.simulation_step *= process.RHDecayTracer
 
         return (process)
@@ -0,0 +1,82 @@
+#include "SimG4Core/CustomPhysics/interface/ChannelAliasTable.h"
+
+void ChannelAliasTable::channelWeights(const std::vector<Channel>& channels,
+                                       double p22,
+                                       double suppression,
+                                       std::vector<double>& weights) {
+  std::size_t n22 = 0;
+  for (const Channel& channel : channels)
+    if (channel.twoBody)
+      ++n22;
+  const std::size_t n23 = channels.size() - n22;
+  if (n23 == 0)
+    p22 = 1.;
+  else if (n22 == 0)
+    p22 = 0.;
+
+  // Proposal probability times acceptance, then normalised
+  weights.resize(channels.size());
+  double total = 0.;
+  for (std::size_t i = 0; i < channels.size(); ++i) {
+    const Channel& channel = channels[i];
+    double weight = channel.twoBody ? p22 / n22 : (1. - p22) / n23 * channel.acceptance;
+    if (channel.chargeChange)
+      weight *= 1. - suppression;
+    weights[i] = weight;
+    total += weight;
+  }
+
+  if (total <= 0.) {
+    // Nothing can be accepted: the rejection loop gave up and kept its last proposal
+    for (std::size_t i = 0; i < channels.size(); ++i)
+      weights[i] = channels[i].twoBody ? p22 / n22 : (1. - p22) / n23;
+    total = 1.;
+  }
+  for (double& weight : weights)
+    weight /= total;
+}
+
+std::size_t ChannelAliasTable::addBin(const std::vector<double>& weights) {
+  if (offsets_.empty())
+    offsets_.push_back(0);
+  const std::size_t n = weights.size();
+  const std::uint32_t offset = offsets_.back();
+  offsets_.push_back(offset + n);
+  probability_.resize(offset + n);
+  alias_.resize(offset + n);
+
+  double total = 0.;
+  for (double weight : weights)
+    total += weight;
+
+  // Vose's construction: slots below the mean are topped up by an alias above it
+  std::vector<double> scaled(n);
+  std::vector<std::size_t> small, large;
+  for (std::size_t i = 0; i < n; ++i) {
+    scaled[i] = (total > 0.) ? weights[i] * n / total : 1.;
+    (scaled[i] < 1. ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    const std::size_t s = small.back();
+    const std::size_t l = large.back();
+    small.pop_back();
+    probability_[offset + s] = scaled[s];
+    alias_[offset + s] = l;
+    scaled[l] -= 1. - scaled[s];
+    if (scaled[l] < 1.) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // What is left is 1 up to rounding
+  for (std::size_t i : large) {
+    probability_[offset + i] = 1.f;
+    alias_[offset + i] = i;
+  }
+  for (std::size_t i : small) {
+    probability_[offset + i] = 1.f;
+    alias_[offset + i] = i;
+  }
+
+  return offsets_.size() - 2;
+}
@@ -0,0 +1,67 @@
+#include "SimG4Core/CustomPhysics/interface/CustomParticleRegistry.h"
+#include "SimG4Core/CustomPhysics/interface/CustomPDGParser.h"
+#include "SimG4Core/CustomPhysics/interface/CustomParticle.h"
+
+#include "G4ParticleDefinition.hh"
+
+#include <numeric>
+
+void CustomParticleRegistry::add(G4ParticleDefinition* aParticle) {
+  if (!aParticle)
+    return;
+  const G4int pdgCode = aParticle->GetPDGEncoding();
+  if (std::find(codes_.begin(), codes_.end(), pdgCode) != codes_.end())
+    return;
+
+  Entry entry;
+  entry.definition = aParticle;
+  CustomParticle* custom = dynamic_cast<CustomParticle*>(aParticle);
+  entry.cloud = custom ? custom->GetCloud() : nullptr;
+  entry.mass = aParticle->GetPDGMass();
+  entry.charge = aParticle->GetPDGCharge();
+
+  const G4String& type = aParticle->GetParticleType();
+  entry.classes = 0;
+  if (type == "rhadron" || type == "mesonino" || type == "sbaryon")
+    entry.classes |= kRHadronType;
+  if (custom)
+    entry.classes |= kCustomParticle;
+  if (CustomPDGParser::s_isMesonino(pdgCode))
+    entry.classes |= kMesonino;
+  if (CustomPDGParser::s_isSbaryon(pdgCode))
+    entry.classes |= kSbaryon;
+  if (CustomPDGParser::s_isRMeson(pdgCode))
+    entry.classes |= kRMeson;
+  if (CustomPDGParser::s_isRBaryon(pdgCode))
+    entry.classes |= kRBaryon;
+  if (CustomPDGParser::s_isRGlueball(pdgCode))
+    entry.classes |= kRGlueball;
+
+  entry.quarks.fill(0);
+  if (!(entry.classes & kRGlueball)) {
+    for (G4int quark : CustomPDGParser::s_containedQuarks(pdgCode)) {
+      if (quark >= 1 && quark <= 6)
+        ++entry.quarks[quark - 1];
+    }
+  }
+
+  codes_.push_back(pdgCode);
+  entries_.push_back(entry);
+}
+
+void CustomParticleRegistry::build() {
+  std::vector<std::size_t> order(codes_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) { return codes_[a] < codes_[b]; });
+
+  std::vector<G4int> codes;
+  std::vector<Entry> entries;
+  codes.reserve(order.size());
+  entries.reserve(order.size());
+  for (std::size_t i : order) {
+    codes.push_back(codes_[i]);
+    entries.push_back(entries_[i]);
+  }
+  codes_.swap(codes);
+  entries_.swap(entries);
+}
@@ -64,9 +64,10 @@ void CustomPhysicsList::ConstructProcess() {
 
   // Set the pythia decayer for Rhadrons
   G4Decay* decay = new G4Decay(); // Used to check if decay is applicable for particles
-  G4Decay* pythiaDecayProcess = new RHadronPythiaDecayer(myConfig);
+  RHadronPythiaDecayer* pythiaDecayProcess = new RHadronPythiaDecayer(myConfig);
   G4VExtDecayer* extDecayer = dynamic_cast<G4VExtDecayer*>(pythiaDecayProcess);
   pythiaDecayProcess->SetExtDecayer(extDecayer); // Set the external decayer to itself. Seems redundant but is necessary as far as I can tell. Without doing this, RHadronPythiaDecayer::ImportDecayProducts() will not be called.
+  std::vector<int> decayingRhadrons; // PDG ids of the particles decayed by RHadronPythiaDecayer
 
   for (auto particle : fParticleFactory.get()->getCustomParticles()) {
     if (particle->GetParticleType() == "simp") {
@@ -128,12 +129,14 @@ void CustomPhysicsList::ConstructProcess() {
           pmanager->AddProcess(pythiaDecayProcess);
           pmanager->SetProcessOrdering(pythiaDecayProcess, idxPostStep);
           pythiaDecayProcess->SetVerboseLevel(2);
+          decayingRhadrons.push_back(particle->GetPDGEncoding());
         } else {
           edm::LogVerbatim("SimG4CoreCustomPhysics") << "CustomPhysicsList: No decay allowed for " << particle->GetParticleName();
           if (!particle->GetPDGStable() && particle->GetPDGLifeTime() < 0.1 * CLHEP::ns) {
             edm::LogVerbatim("SimG4CoreCustomPhysics") << "CustomPhysicsList: Gonna decay it anyway!!!";
             pmanager->AddProcess(pythiaDecayProcess);
             pmanager->SetProcessOrdering(pythiaDecayProcess, idxPostStep);
+            decayingRhadrons.push_back(particle->GetPDGEncoding());
           }
         }
         
@@ -159,4 +162,9 @@ void CustomPhysicsList::ConstructProcess() {
       }
     }
   }
+
+  // The decay library, if requested, is built once on the master thread before the workers start decaying R-hadrons
+  if (G4Threading::IsMasterThread()) {
+    pythiaDecayProcess->buildDecayLibrary(decayingRhadrons);
+  }
 }
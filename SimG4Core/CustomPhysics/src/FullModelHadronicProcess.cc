@@ -1,17 +1,41 @@
 #include "G4ProcessManager.hh"
 #include "G4ParticleTable.hh"
 #include "G4HadronicException.hh"
+#include "G4Material.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Region.hh"
 
 #include "SimG4Core/CustomPhysics/interface/FullModelHadronicProcess.h"
 #include "SimG4Core/CustomPhysics/interface/G4ProcessHelper.h"
 #include "SimG4Core/CustomPhysics/interface/Decay3Body.h"
 #include "SimG4Core/CustomPhysics/interface/CustomPDGParser.h"
 #include "SimG4Core/CustomPhysics/interface/CustomParticle.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include <algorithm>
+#include <atomic>
 
 using namespace CLHEP;
 
+namespace {
+  //A majorant bounds the cross section below the energy it was computed at; it is recomputed once the R-hadron has
+  //slowed down below this fraction of that energy, to keep it close
+  constexpr double kMajorantEnergyFraction = 0.9;
+
+  //Set on the first interaction whose cross section exceeds the majorant, so that it is only reported once per job
+  std::atomic<bool> majorantExceededReported(false);
+}  // namespace
+
 FullModelHadronicProcess::FullModelHadronicProcess(G4ProcessHelper* aHelper, const G4String& processName)
-    : G4VDiscreteProcess(processName), theHelper(aHelper) {}
+    : G4VDiscreteProcess(processName),
+      theHelper(aHelper),
+      majorantParticle(nullptr),
+      majorantRegion(nullptr),
+      majorantKineticEnergy(0.),
+      majorantCrossSection(0.),
+      majorantRegionFactor(0.),
+      majorantSampled(false) {}
 
 FullModelHadronicProcess::~FullModelHadronicProcess() {}
 
@@ -27,19 +51,52 @@ G4double FullModelHadronicProcess::GetMicroscopicCrossSection(const G4DynamicPar
   return InclXsec;
 }
 
+void FullModelHadronicProcess::BuildPhysicsTable(const G4ParticleDefinition&) {
+  //The material data do not depend on the R-hadron; materials created later are filled on first use
+  theHelper->BuildMaterialData();
+}
+
+G4double FullModelHadronicProcess::MajorantMeanFreePath(const G4Track& aTrack) {
+  const G4DynamicParticle* aParticle = aTrack.GetDynamicParticle();
+  const G4Region* aRegion = aTrack.GetVolume()->GetLogicalVolume()->GetRegion();
+  const G4double kineticEnergy = aParticle->GetKineticEnergy();
+  if (aParticle->GetDefinition() != majorantParticle || aRegion != majorantRegion ||
+      kineticEnergy > majorantKineticEnergy || kineticEnergy < kMajorantEnergyFraction * majorantKineticEnergy) {
+    majorantParticle = aParticle->GetDefinition();
+    majorantRegion = aRegion;
+    majorantKineticEnergy = kineticEnergy;
+    majorantCrossSection = theHelper->GetMajorantCrossSectionPerNucleon(aParticle);
+    majorantRegionFactor = theHelper->RegionMaterialFactor(aRegion);
+  }
+  //The material list of the region need not hold the material of the track, e.g. for volumes of a daughter region
+  const G4double sigma =
+      std::max(majorantRegionFactor, theHelper->MaterialFactor(aTrack.GetMaterial())) * majorantCrossSection;
+  return (sigma > 0.0) ? 1. / sigma : DBL_MAX;
+}
+
 G4double FullModelHadronicProcess::GetMeanFreePath(const G4Track& aTrack, G4double, G4ForceCondition*) {
+  majorantSampled = theHelper->WoodcockTracking() &&
+                    exactRegions.count(aTrack.GetVolume()->GetLogicalVolume()->GetRegion()) == 0;
+  if (majorantSampled)
+    return MajorantMeanFreePath(aTrack);
+
   G4Material* aMaterial = aTrack.GetMaterial();
   const G4DynamicParticle* aParticle = aTrack.GetDynamicParticle();
   G4double sigma = 0.0;
 
-  G4int nElements = aMaterial->GetNumberOfElements();
+  if (theHelper->AnalyticCrossSections()) {
+    //Validation mode: sum the microscopic cross sections of the elements
+    G4int nElements = aMaterial->GetNumberOfElements();
 
-  const G4double* theAtomicNumDensityVector = aMaterial->GetAtomicNumDensityVector();
-  G4double aTemp = aMaterial->GetTemperature();
+    const G4double* theAtomicNumDensityVector = aMaterial->GetAtomicNumDensityVector();
+    G4double aTemp = aMaterial->GetTemperature();
 
-  for (G4int i = 0; i < nElements; ++i) {
-    G4double xSection = GetMicroscopicCrossSection(aParticle, (*aMaterial->GetElementVector())[i], aTemp);
-    sigma += theAtomicNumDensityVector[i] * xSection;
+    for (G4int i = 0; i < nElements; ++i) {
+      G4double xSection = GetMicroscopicCrossSection(aParticle, (*aMaterial->GetElementVector())[i], aTemp);
+      sigma += theAtomicNumDensityVector[i] * xSection;
+    }
+  } else {
+    sigma = theHelper->MaterialFactor(aMaterial) * theHelper->GetCrossSectionPerNucleon(aParticle);
   }
   G4double res = DBL_MAX;
   if (sigma > 0.0) {
@@ -53,12 +110,35 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
 
   // Initialize parameters
   aParticleChange.Initialize(aTrack);
+
+  // With delta tracking the interaction was sampled with the majorant of the region. It happens with the ratio of the
+  // cross section in the material to the majorant, otherwise this is a null collision and the track is unchanged
+  if (majorantSampled) {
+    const G4double sigma = theHelper->MaterialFactor(aTrack.GetMaterial()) *
+                           theHelper->GetCrossSectionPerNucleon(aTrack.GetDynamicParticle());
+    const G4double ratio = sigma * currentInteractionLength;
+    //A ratio above 1 means the majorant is not one and this interaction was undersampled. It is accepted, and the
+    //region falls back to the exact mean free path from the next step on
+    if (ratio > 1.) {
+      const G4Region* aRegion = aTrack.GetVolume()->GetLogicalVolume()->GetRegion();
+      exactRegions.insert(aRegion);
+      if (!majorantExceededReported.exchange(true))
+        edm::LogWarning("SimG4CoreCustomPhysics")
+            << "FullModelHadronicProcess: The cross section of " << aTrack.GetDefinition()->GetParticleName() << " in "
+            << aTrack.GetMaterial()->GetName() << " at " << aTrack.GetKineticEnergy() / GeV
+            << " GeV exceeds the majorant of delta tracking by a factor " << ratio << ". Delta tracking is disabled in"
+            << " region " << aRegion->GetName() << ". This is only reported once.";
+    }
+    if (G4UniformRand() >= ratio) {
+      ClearNumberOfInteractionLengthLeft();
+      return &aParticleChange;
+    }
+  }
   const G4DynamicParticle* incomingRhadron = aTrack.GetDynamicParticle();
   CustomParticle* customIncomingRhadron =
       static_cast<CustomParticle*>(incomingRhadron->GetDefinition());  // This is used to get the cloud particle
   const G4ThreeVector& aPosition = aTrack.GetPosition();               // Position of the track
   const G4int incomingRhadronPDG = incomingRhadron->GetDefinition()->GetPDGEncoding();
-  G4ParticleTable* theParticleTable = G4ParticleTable::GetParticleTable();
   G4bool incomingRhadronSurvives = false;
   G4bool TargetSurvives = false;
   G4Nucleus targetNucleus(aTrack.GetMaterial());
@@ -67,29 +147,30 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
   G4ParticleDefinition* outgoingCloudDefinition = nullptr;
   G4ParticleDefinition* outgoingTargetDefinition = nullptr;
 
-  // Declare the quark cloud as a G4DynamicParticle
-  G4DynamicParticle* cloudParticle = new G4DynamicParticle();
-  cloudParticle->SetDefinition(customIncomingRhadron->GetCloud());
+  // Declare the quark cloud as a G4DynamicParticle. The temporaries of the interaction live on the stack; only the
+  // particles of the secondary tracks are allocated
+  G4DynamicParticle cloudParticle;
+  cloudParticle.SetDefinition(customIncomingRhadron->GetCloud());
 
   // Define the gluino and quark cloud G4LorentzVector (momentum, total energy) based on the momentum of the R-hadron and the ratio of the masses
-  double scale = cloudParticle->GetDefinition()->GetPDGMass() / incomingRhadron->GetDefinition()->GetPDGMass();
+  double scale = cloudParticle.GetDefinition()->GetPDGMass() / incomingRhadron->GetDefinition()->GetPDGMass();
   G4LorentzVector cloudMomentum(
       incomingRhadron->GetMomentum() * scale,
       std::sqrt(incomingRhadron->GetMomentum().mag() * scale * incomingRhadron->GetMomentum().mag() * scale +
-                cloudParticle->GetDefinition()->GetPDGMass() * cloudParticle->GetDefinition()->GetPDGMass()));
-  cloudParticle->Set4Momentum(cloudMomentum);
+                cloudParticle.GetDefinition()->GetPDGMass() * cloudParticle.GetDefinition()->GetPDGMass()));
+  cloudParticle.Set4Momentum(cloudMomentum);
   G4LorentzVector gluinoMomentum(incomingRhadron->GetMomentum() * (1. - scale),
-                                 incomingRhadron->GetTotalEnergy() - cloudParticle->GetTotalEnergy());
+                                 incomingRhadron->GetTotalEnergy() - cloudParticle.GetTotalEnergy());
 
   // Update the cloud kinetic energy based on the target nucleus and evaporative effects
-  G4double cloudKineticEnergy = cloudParticle->GetKineticEnergy();
-  G4double initialCloudEnergy = cloudParticle->GetTotalEnergy();
+  G4double cloudKineticEnergy = cloudParticle.GetKineticEnergy();
+  G4double initialCloudEnergy = cloudParticle.GetTotalEnergy();
   cloudKineticEnergy += targetNucleus.Cinema(cloudKineticEnergy);
   cloudKineticEnergy -= targetNucleus.EvaporationEffects(cloudKineticEnergy);
 
-  G4ThreeVector cloud3MomentumDirection = cloudParticle->GetMomentum().unit();
+  G4ThreeVector cloud3MomentumDirection = cloudParticle.GetMomentum().unit();
   G4double cloud3MomentumMagnitudeAfterEvaporativeEffects =
-      std::sqrt(cloudKineticEnergy * (cloudKineticEnergy + 2. * cloudParticle->GetDefinition()->GetPDGMass()));
+      std::sqrt(cloudKineticEnergy * (cloudKineticEnergy + 2. * cloudParticle.GetDefinition()->GetPDGMass()));
 
   // If the R-hadron kinetic energy is less than 0.1 MeV, or the cloud kinetic energy is less than or equal to 0, stop the track but keep it alive. This should be very rare.
   if (cloudKineticEnergy + gluinoMomentum.e() - gluinoMomentum.m() <= 0.1 * MeV || cloudKineticEnergy <= 0.) {
@@ -97,43 +178,45 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
     return &aParticleChange;
   }
 
-  cloudParticle->SetKineticEnergy(cloudKineticEnergy);
-  cloudParticle->SetMomentum(cloud3MomentumMagnitudeAfterEvaporativeEffects * cloud3MomentumDirection);
+  cloudParticle.SetKineticEnergy(cloudKineticEnergy);
+  cloudParticle.SetMomentum(cloud3MomentumMagnitudeAfterEvaporativeEffects * cloud3MomentumDirection);
 
   //Get the final state particles. reactionProduct is a vector of integer PDGIDs. Not to be confused with G4ReactionProduct
   G4ParticleDefinition* aTarget;
-  ReactionProduct reactionProduct = theHelper->GetFinalState(aTrack, aTarget);
+  const ReactionProduct& reactionProduct = theHelper->GetFinalState(aTrack, aTarget);
   G4int reactionProductSize = reactionProduct.size();
 
   //Process outgoing particles from reactions
-  std::vector<G4ParticleDefinition*> outgoingParticleDefinitions;
-  for (ReactionProduct::iterator it = reactionProduct.begin(); it != reactionProduct.end(); ++it) {
-    G4ParticleDefinition* finalStateParticle = theParticleTable->FindParticle(*it);
-    CustomParticle* finalStateCustomParticle = dynamic_cast<CustomParticle*>(finalStateParticle);
+  const CustomParticleRegistry& particleRegistry = theHelper->GetParticleRegistry();
+  G4ParticleDefinition* outgoingParticleDefinitions[ReactionProduct::kMaxProducts];
+  G4int nOutgoingParticles = 0;
+  for (ReactionProduct::const_iterator it = reactionProduct.begin(); it != reactionProduct.end(); ++it) {
+    const CustomParticleRegistry::Entry& finalStateEntry = *particleRegistry.find(*it);
+    G4ParticleDefinition* finalStateParticle = finalStateEntry.definition;
 
     if (finalStateParticle == aTarget) {
       TargetSurvives = true;
     }
 
-    if (finalStateParticle->GetParticleType() == "rhadron" || finalStateParticle->GetParticleType() == "mesonino" || finalStateParticle->GetParticleType() == "sbaryon") {
+    if (finalStateEntry.is(CustomParticleRegistry::kRHadronType)) {
       outgoingRhadronDefinition = finalStateParticle;
-      outgoingCloudDefinition = finalStateCustomParticle->GetCloud();
+      outgoingCloudDefinition = finalStateEntry.cloud;
     }
 
     if (finalStateParticle == G4Proton::Proton() || finalStateParticle == G4Neutron::Neutron())
       outgoingTargetDefinition = finalStateParticle;
-    if (finalStateCustomParticle == nullptr && reactionProduct.size() == 2)
+    if (!finalStateEntry.is(CustomParticleRegistry::kCustomParticle) && reactionProduct.size() == 2)
       outgoingTargetDefinition = finalStateParticle;
     if (finalStateParticle->GetPDGEncoding() == incomingRhadronPDG) {
       incomingRhadronSurvives = true;
     } else {
-      outgoingParticleDefinitions.push_back(finalStateParticle);
+      outgoingParticleDefinitions[nOutgoingParticles++] = finalStateParticle;
     }
   }
 
   //If no reaction occured, set the outgoingTargetDefinition to the original target definition
   if (outgoingTargetDefinition == nullptr)
-    outgoingTargetDefinition = theParticleTable->FindParticle(reactionProduct[1]);
+    outgoingTargetDefinition = particleRegistry.find(reactionProduct[1])->definition;
 
   //If the incident particle survives, decrement the number of secondaries
   if (incomingRhadronSurvives)
@@ -141,25 +224,24 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
   aParticleChange.SetNumberOfSecondaries(reactionProductSize);
 
   //Create G4DynamicParticle and G4ReactionProduct objects for the outgoing target particle
-  G4DynamicParticle* outgoingTargetG4Dynamic = new G4DynamicParticle;
+  G4DynamicParticle outgoingTargetG4Dynamic;
   G4ReactionProduct outgoingTargetG4Reaction;
   if (TargetSurvives) {
-    outgoingTargetG4Dynamic->SetDefinition(aTarget);
+    outgoingTargetG4Dynamic.SetDefinition(aTarget);
     outgoingTargetG4Reaction = G4ReactionProduct(aTarget);
   } else {
-    outgoingTargetG4Dynamic->SetDefinition(outgoingTargetDefinition);
+    outgoingTargetG4Dynamic.SetDefinition(outgoingTargetDefinition);
     outgoingTargetG4Reaction = G4ReactionProduct(outgoingTargetDefinition);
   }
 
-  //Calculate the Lorentz boost of the cloud particle to the lab frame
-  G4HadProjectile* incomingCloudG4HadProjectile = new G4HadProjectile(*cloudParticle);
-  G4LorentzRotation cloudParticleToLabFrameRotation = incomingCloudG4HadProjectile->GetTrafoToLab();
+  //The reaction is calculated in the frame where the cloud moves along z, as in G4HadProjectile. Its rotation to the lab
+  //frame (G4HadProjectile::GetTrafoToLab) is rotateUz with the direction of the cloud
+  const G4ThreeVector cloudDirection = cloudParticle.GetMomentumDirection();
 
   //Create a G4ReactionProduct object for the outgoing cloud
-  G4ReactionProduct outgoingCloudG4Reaction(
-      const_cast<G4ParticleDefinition*>(incomingCloudG4HadProjectile->GetDefinition()));
-  outgoingCloudG4Reaction.SetMomentum(incomingCloudG4HadProjectile->Get4Momentum().vect());
-  outgoingCloudG4Reaction.SetTotalEnergy(incomingCloudG4HadProjectile->GetTotalEnergy());
+  G4ReactionProduct outgoingCloudG4Reaction(cloudParticle.GetDefinition());
+  outgoingCloudG4Reaction.SetMomentum(0., 0., cloudParticle.GetTotalMomentum());
+  outgoingCloudG4Reaction.SetTotalEnergy(cloudParticle.GetTotalEnergy());
   if (!incomingRhadronSurvives) {
     outgoingCloudG4Reaction.SetDefinitionAndUpdateE(outgoingCloudDefinition);
   }
@@ -176,42 +258,52 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
   G4int secondaryParticleVectorLen = 0;
   secondaryParticleVector.Initialize(0);
 
-  //Fill the vector with the secondary particles
-  for (G4int i = 0; i != reactionProductSize; i++) {
-    if (outgoingParticleDefinitions[i] != aTarget &&
-        outgoingParticleDefinitions[i] != incomingCloudG4HadProjectile->GetDefinition() &&
-        outgoingParticleDefinitions[i] != outgoingRhadronDefinition &&
-        outgoingParticleDefinitions[i] != outgoingTargetDefinition) {
-      G4ReactionProduct* secondaryReactionProduct = new G4ReactionProduct;
-      secondaryReactionProduct->SetDefinition(outgoingParticleDefinitions[i]);
-      (G4UniformRand() < 0.5)
-          ? secondaryReactionProduct->SetSide(-1)
-          : secondaryReactionProduct->SetSide(1);  //Here we randomly determine the hemisphere of the secondary particle
-      secondaryParticleVector.SetElement(secondaryParticleVectorLen++, secondaryReactionProduct);
+  G4bool targetHasChanged = !TargetSurvives;
+  if (quasiElastic) {
+    //Elastic or charge exchange scattering of the cloud off the nucleon. Both products are the R-hadron and the target,
+    //so there are no secondaries, and TwoBody needs neither the projectile nor the cluster machinery
+    incomingCloud3Momentum = G4ThreeVector(0., 0., cloudParticle.GetTotalMomentum());
+    theReactionDynamics.TwoBody(secondaryParticleVector,
+                                secondaryParticleVectorLen,
+                                modifiedoutgoingCloudG4Reaction,
+                                &outgoingTargetG4Dynamic,
+                                outgoingCloudG4Reaction,
+                                outgoingTargetG4Reaction,
+                                targetNucleus,
+                                targetHasChanged);
+  } else {
+    //Fill the vector with the secondary particles. They stay heap allocated, as FullModelReactionDynamics deletes and
+    //adds elements of the vector
+    for (G4int i = 0; i != nOutgoingParticles; i++) {
+      if (outgoingParticleDefinitions[i] != aTarget && outgoingParticleDefinitions[i] != cloudParticle.GetDefinition() &&
+          outgoingParticleDefinitions[i] != outgoingRhadronDefinition &&
+          outgoingParticleDefinitions[i] != outgoingTargetDefinition) {
+        G4ReactionProduct* secondaryReactionProduct = new G4ReactionProduct;
+        secondaryReactionProduct->SetDefinition(outgoingParticleDefinitions[i]);
+        (G4UniformRand() < 0.5)
+            ? secondaryReactionProduct->SetSide(-1)
+            : secondaryReactionProduct->SetSide(1);  //Here we randomly determine the hemisphere of the secondary particle
+        secondaryParticleVector.SetElement(secondaryParticleVectorLen++, secondaryReactionProduct);
+      }
     }
-  }
 
-  //Store the outgoing Cloud 4-momentum for energy deposit calculation that occurs after change in momemta has been calculated
-  G4LorentzVector outgoingCloudp4(outgoingCloudG4Reaction.GetMomentum(), outgoingCloudG4Reaction.GetTotalEnergy());
-  outgoingCloudp4 *= cloudParticleToLabFrameRotation;
+    const G4HadProjectile incomingCloudG4HadProjectile(cloudParticle);
+    G4bool incomingRhadronHasChanged = !incomingRhadronSurvives;
+    CalculateMomenta(secondaryParticleVector,
+                     secondaryParticleVectorLen,
+                     &incomingCloudG4HadProjectile,
+                     &outgoingTargetG4Dynamic,
+                     modifiedoutgoingCloudG4Reaction,
+                     targetNucleus,
+                     outgoingCloudG4Reaction,
+                     outgoingTargetG4Reaction,
+                     incomingRhadronHasChanged,
+                     targetHasChanged);
+  }
 
-  G4bool incomingRhadronHasChanged = !incomingRhadronSurvives;
-  G4bool targetHasChanged = !TargetSurvives;
-  CalculateMomenta(secondaryParticleVector,
-                   secondaryParticleVectorLen,
-                   incomingCloudG4HadProjectile,
-                   outgoingTargetG4Dynamic,
-                   modifiedoutgoingCloudG4Reaction,
-                   targetNucleus,
-                   outgoingCloudG4Reaction,
-                   outgoingTargetG4Reaction,
-                   incomingRhadronHasChanged,
-                   targetHasChanged,
-                   quasiElastic);
-
-  //Declare the Cloud 4-momentum after the interaction and propose an energy deposit of the difference between the incoming and outgoing quark cloud energies
-  G4LorentzVector outgoingCloudp4Prime(outgoingCloudG4Reaction.GetMomentum(), outgoingCloudG4Reaction.GetTotalEnergy());
-  outgoingCloudp4Prime *= cloudParticleToLabFrameRotation;
+  //Declare the Cloud momentum after the interaction and propose an energy deposit of the difference between the incoming and outgoing quark cloud energies
+  G4ThreeVector outgoingCloud3MomentumPrime = outgoingCloudG4Reaction.GetMomentum();
+  outgoingCloud3MomentumPrime.rotateUz(cloudDirection);
   G4double proposedEnergyDeposit = initialCloudEnergy - outgoingCloudG4Reaction.GetTotalEnergy();
 
   if (proposedEnergyDeposit > 0) {
@@ -222,10 +314,10 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
   aParticleChange.SetNumberOfSecondaries(secondaryParticleVectorLen + reactionProductSize);
 
   //If the incident particle does not survive, update the outgoing track to be the new R-Hadron with the proper momentum, time, and position
-  G4DynamicParticle* dynamicOutgoingRhadron = new G4DynamicParticle;
   if (!incomingRhadronSurvives) {
+    G4DynamicParticle* dynamicOutgoingRhadron = new G4DynamicParticle;
     dynamicOutgoingRhadron->SetDefinition(outgoingRhadronDefinition);
-    dynamicOutgoingRhadron->SetMomentum(gluinoMomentum.vect() + outgoingCloudp4Prime.vect());
+    dynamicOutgoingRhadron->SetMomentum(gluinoMomentum.vect() + outgoingCloud3MomentumPrime);
 
     G4Track* outgoingRhadronTrack = new G4Track(dynamicOutgoingRhadron, aTrack.GetGlobalTime(), aPosition);
     outgoingRhadronTrack->SetTouchableHandle(thisTouchable);
@@ -237,25 +329,25 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
 
   //If the incident particle survives update its momentum direction. Includes error handling for when the momentum is zero
   else {
-    dynamicOutgoingRhadron->SetDefinition(incomingRhadron->GetDefinition());
-    dynamicOutgoingRhadron->SetMomentum(gluinoMomentum.vect() + outgoingCloudp4Prime.vect());
-    if (dynamicOutgoingRhadron->GetMomentum().mag() > DBL_MIN)
-      aParticleChange.ProposeMomentumDirection(dynamicOutgoingRhadron->GetMomentumDirection());
+    G4DynamicParticle dynamicOutgoingRhadron;
+    dynamicOutgoingRhadron.SetDefinition(incomingRhadron->GetDefinition());
+    dynamicOutgoingRhadron.SetMomentum(gluinoMomentum.vect() + outgoingCloud3MomentumPrime);
+    if (dynamicOutgoingRhadron.GetMomentum().mag() > DBL_MIN)
+      aParticleChange.ProposeMomentumDirection(dynamicOutgoingRhadron.GetMomentumDirection());
     else
       aParticleChange.ProposeMomentumDirection(1.0, 0.0, 0.0);
-    aParticleChange.ProposeEnergy(dynamicOutgoingRhadron->GetKineticEnergy());
+    aParticleChange.ProposeEnergy(dynamicOutgoingRhadron.GetKineticEnergy());
   }
 
   //Update the momenta of the target track
-  G4DynamicParticle* targetParticleG4DynamicAfterInteraction = new G4DynamicParticle;
   if (outgoingTargetG4Reaction.GetMass() > 0.0)  // outgoingTargetG4Reaction can be eliminated in TwoBody
   {
+    G4DynamicParticle* targetParticleG4DynamicAfterInteraction = new G4DynamicParticle;
     targetParticleG4DynamicAfterInteraction->SetDefinition(outgoingTargetG4Reaction.GetDefinition());
-    targetParticleG4DynamicAfterInteraction->SetMomentum(outgoingTargetG4Reaction.GetMomentum().rotate(
+    G4ThreeVector targetMomentum = outgoingTargetG4Reaction.GetMomentum().rotate(
         2. * pi * G4UniformRand(),
-        incomingCloud3Momentum));  // rotate(const G4double angle, const ThreeVector &axis) const;
-    targetParticleG4DynamicAfterInteraction->SetMomentum(
-        (cloudParticleToLabFrameRotation * targetParticleG4DynamicAfterInteraction->Get4Momentum()).vect());
+        incomingCloud3Momentum);  // rotate(const G4double angle, const ThreeVector &axis) const;
+    targetParticleG4DynamicAfterInteraction->SetMomentum(targetMomentum.rotateUz(cloudDirection));
     G4Track* targetTrackAfterInteraction =
         new G4Track(targetParticleG4DynamicAfterInteraction, aTrack.GetGlobalTime(), aPosition);
     targetTrackAfterInteraction->SetTouchableHandle(thisTouchable);
@@ -266,9 +358,8 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
   for (int i = 0; i < secondaryParticleVectorLen; ++i) {
     G4DynamicParticle* secondaryParticleAfterInteraction = new G4DynamicParticle();
     secondaryParticleAfterInteraction->SetDefinition(secondaryParticleVector[i]->GetDefinition());
-    secondaryParticleAfterInteraction->SetMomentum(secondaryParticleVector[i]->GetMomentum());
-    secondaryParticleAfterInteraction->SetMomentum(
-        (cloudParticleToLabFrameRotation * secondaryParticleAfterInteraction->Get4Momentum()).vect());
+    G4ThreeVector secondaryMomentum = secondaryParticleVector[i]->GetMomentum();
+    secondaryParticleAfterInteraction->SetMomentum(secondaryMomentum.rotateUz(cloudDirection));
     G4Track* secondaryTrackAfterInteraction =
         new G4Track(secondaryParticleAfterInteraction, aTrack.GetGlobalTime(), aPosition);
     secondaryTrackAfterInteraction->SetTouchableHandle(thisTouchable);
@@ -277,8 +368,6 @@ G4VParticleChange* FullModelHadronicProcess::PostStepDoIt(const G4Track& aTrack,
     delete secondaryParticleVector[i];
   }
 
-  delete incomingCloudG4HadProjectile;
-  delete outgoingTargetG4Dynamic;
   //aParticleChange.DumpInfo();
   ClearNumberOfInteractionLengthLeft();
 
@@ -295,26 +384,11 @@ void FullModelHadronicProcess::CalculateMomenta(
     G4ReactionProduct& outgoingCloudG4Reaction,                                //The outgoing cloud G4 Reaction
     G4ReactionProduct& outgoingTargetG4Reaction,  //The outgoing particle previously defined as original target
     G4bool& incomingRhadronHasChanged,            //True if the R-Hadron type has changed
-    G4bool& targetHasChanged,                     //True if the target particle has changed
-    G4bool quasiElastic)                          //True if the reaction product size equals 2, false otherwise
+    G4bool& targetHasChanged)                     //True if the target particle has changed
 {
-  FullModelReactionDynamics theReactionDynamics;
   incomingCloud3Momentum = incomingCloudG4HadProjectile->Get4Momentum().v();  //Use this for rotations later
 
-  //If the reaction is quasi-elastic, use the TwoBody method to calculate the momenta of the outgoing particles.
-  if (quasiElastic) {
-    theReactionDynamics.TwoBody(secondaryParticleVector,
-                                secondaryParticleVectorLen,
-                                modifiedoutgoingCloudG4Reaction,
-                                outgoingTargetG4Dynamic,
-                                outgoingCloudG4Reaction,
-                                outgoingTargetG4Reaction,
-                                targetNucleus,
-                                targetHasChanged);
-    return;
-  }
-
-  //If the reaction is not quasi-elastic, update the outgoing particles momenta based on effects detailed in the functions below. Then call the TwoBody method afterwards
+  //The reaction is not quasi-elastic (those are handled in PostStepDoIt): update the outgoing particles momenta based on effects detailed in the functions below. Then call the TwoBody method afterwards
   G4ReactionProduct leadingStrangeParticle;
   G4bool leadFlag =
       MarkLeadingStrangeParticle(outgoingCloudG4Reaction, outgoingTargetG4Reaction, leadingStrangeParticle);
@@ -8,14 +8,29 @@
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
 
 #include "G4ParticleTable.hh"
+#include "G4Region.hh"
 #include "Randomize.hh"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <string>
 
 using namespace CLHEP;
 
+namespace {
+  //Cross section tables cover boosts from 1 to exp((kNBoostPoints - 1) * kLogBoostStep) = 1e4
+  constexpr int kNBoostPoints = 2049;
+  const double kLogBoostStep = std::log(1e4) / (kNBoostPoints - 1);
+
+  //Flat model sqrt(s) bins start at each reaction threshold and grow by kBinRatio from kFirstBinWidth, the last one
+  //starts kLastBinOffset above the highest threshold, where the phase space factor is 1 to 1e-5
+  constexpr double kFirstBinWidth = 10 * CLHEP::MeV;
+  constexpr double kBinRatio = 1.02;
+  constexpr double kLastBinOffset = 100 * CLHEP::GeV;
+}  // namespace
+
 G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFactory* ptr) {
   fParticleFactory = ptr;
 
@@ -37,6 +52,15 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
   suppressionfactor = p.getParameter<double>("reggeSuppression");
   reggemodel = p.getParameter<bool>("reggeModel");
   mixing = p.getParameter<double>("mixing");
+  analyticCrossSections = p.getUntrackedParameter<bool>("analyticCrossSections", false);
+  woodcockTracking = p.getUntrackedParameter<bool>("woodcockTracking", false);
+  if (woodcockTracking && analyticCrossSections) {
+    edm::LogWarning("SimG4CoreCustomPhysics")
+        << "ProcessHelper: woodcockTracking needs the tabulated cross sections, it is disabled with analyticCrossSections";
+    woodcockTracking = false;
+  }
+  lastTableParticle = nullptr;
+  lastTable = nullptr;
 
   edm::LogInfo("SimG4CoreCustomPhysics") << "ProcessHelper: Read in physics parameters:"
                                          << "\n Resonant = " << resonant << "\n ResonanceEnergy = " << ek_0 / GeV
@@ -50,6 +74,10 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
   n_22 = 0;
   n_23 = 0;
 
+  //Proton- and neutron-scattering processes, compiled into channelTables below
+  ReactionMap pReactionMap;
+  ReactionMap nReactionMap;
+
   while (getline(process_stream, line)) {
     std::vector<G4String> tokens;
     //Getting a line
@@ -61,6 +89,7 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
     //particleTable->DumpTable();
     G4int incidentPDG = incidentDef->GetPDGEncoding();
     known_particles[incidentDef] = true;
+    particleRegistry.add(incidentDef);
 
     G4String target = tokens[1];
     edm::LogInfo("SimG4CoreCustomPhysics") << "ProcessHelper: Incident " << incident << "; Target " << target;
@@ -69,8 +98,15 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
     ReactionProduct prod;
     for (size_t i = 2; i != tokens.size(); i++) {
       G4String part = tokens[i];
-      if (particleTable->contains(part)) {
-        prod.push_back(particleTable->FindParticle(part)->GetPDGEncoding());
+      if (prod.size() == ReactionProduct::kMaxProducts) {
+        G4Exception("G4ProcessHelper",
+                    "TooManyProducts",
+                    FatalException,
+                    "Initialization: A reaction of the reaction product list had more than three products");
+      } else if (particleTable->contains(part)) {
+        G4ParticleDefinition* partDef = particleTable->FindParticle(part);
+        prod.push_back(partDef->GetPDGEncoding());
+        particleRegistry.add(partDef);
       } else {
         G4Exception("G4ProcessHelper",
                     "UnkownParticle",
@@ -92,6 +128,21 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
 
   process_stream.close();
 
+  particleRegistry.add(theProton);
+  particleRegistry.add(theNeutron);
+  for (auto part : fParticleFactory->getCustomParticles())
+    particleRegistry.add(part);
+  particleRegistry.build();
+  CompileChannelTables(pReactionMap, nReactionMap);
+
+  //Tabulate the cross sections of all applicable particles, and the element factors of all elements built so far
+  if (!analyticCrossSections) {
+    for (const auto& known : known_particles)
+      BuildCrossSectionTable(known.first);
+    for (const G4Element* element : *G4Element::GetElementTable())
+      ElementFactor(element);
+  }
+
   for (auto part : fParticleFactory->getCustomParticles()) {
     CustomParticle* particle = dynamic_cast<CustomParticle*>(part);
     if (particle) {
@@ -105,60 +156,185 @@ G4ProcessHelper::G4ProcessHelper(const edm::ParameterSet& p, CustomParticleFacto
 G4ProcessHelper::~G4ProcessHelper() {}
 
 G4bool G4ProcessHelper::ApplicabilityTester(const G4ParticleDefinition& aPart) {
-  const G4ParticleDefinition* aP = &aPart;
-  if (known_particles[aP])
-    return true;
-  return false;
+  //find rather than operator[], which would insert every particle it is asked about
+  const auto it = known_particles.find(&aPart);
+  return it != known_particles.end() && it->second;
 }
 
 G4double G4ProcessHelper::GetInclusiveCrossSection(const G4DynamicParticle* aParticle, const G4Element* anElement) {
-  //We really do need a dedicated class to handle the cross sections. They might not always be constant
+  if (analyticCrossSections)
+    return AnalyticCrossSectionPerNucleon(aParticle) * pow(anElement->GetN(), 0.7) * 1.25;  // * 0.523598775598299;
+  return GetCrossSectionPerNucleon(aParticle) * ElementFactor(anElement);
+}
 
-  //Disassemble the PDG-code
+const G4ProcessHelper::CrossSectionTable* G4ProcessHelper::FindCrossSectionTable(const G4ParticleDefinition* aParticle) {
+  if (aParticle != lastTableParticle) {
+    const auto it = crossSectionTables.find(aParticle);
+    lastTableParticle = aParticle;
+    lastTable = it != crossSectionTables.end() ? &it->second : nullptr;
+  }
+  return lastTable;
+}
 
-  G4int thePDGCode = aParticle->GetDefinition()->GetPDGEncoding();
-  double boost = (aParticle->GetKineticEnergy() + aParticle->GetMass()) / aParticle->GetMass();
-  //  G4cout<<"thePDGCode: "<<thePDGCode<<G4endl;
+G4double G4ProcessHelper::GetCrossSectionPerNucleon(const G4DynamicParticle* aParticle) {
+  FindCrossSectionTable(aParticle->GetDefinition());
+  const double boost = (aParticle->GetKineticEnergy() + aParticle->GetMass()) / aParticle->GetMass();
+  const double u = std::log(boost) / kLogBoostStep;
+  if (!lastTable || !(u < kNBoostPoints - 1))
+    return AnalyticCrossSectionPerNucleon(aParticle);
+
+  //Linear interpolation in log(boost)
+  const int i = std::max(0, static_cast<int>(u));
+  const double f = u - i;
+  G4double theXsec = (1. - f) * lastTable->nonResonant[i] + f * lastTable->nonResonant[i + 1];
+
+  //The narrow resonance is not tabulated, but evaluated from the constants of the species
+  if (resonant) {
+    const double sqrts = std::sqrt(lastTable->m2PlusMp2 + 2 * aParticle->GetTotalEnergy() * theProton->GetPDGMass());
+    const double halfGamma2 = gamma * gamma / 4.;
+    theXsec += amplitude * halfGamma2 / ((sqrts - lastTable->resonanceE0) * (sqrts - lastTable->resonanceE0) + halfGamma2);
+  }
+  return theXsec;
+}
+
+G4double G4ProcessHelper::GetMajorantCrossSectionPerNucleon(const G4DynamicParticle* aParticle) {
+  const CrossSectionTable* table = FindCrossSectionTable(aParticle->GetDefinition());
+  if (!table)
+    return AnalyticCrossSectionPerNucleon(aParticle);
+
+  const double boost = (aParticle->GetKineticEnergy() + aParticle->GetMass()) / aParticle->GetMass();
+  const double u = std::log(boost) / kLogBoostStep;
+  const bool inTable = u < kNBoostPoints - 1;
+  G4double theXsec = inTable ? table->nonResonantMax[std::max(0, static_cast<int>(u))] : table->nonResonantMax.back();
+
+  //The Breit-Wigner rises up to the resonance and is at most the amplitude
+  if (resonant) {
+    const double sqrts = std::sqrt(table->m2PlusMp2 + 2 * aParticle->GetTotalEnergy() * theProton->GetPDGMass());
+    const double halfGamma2 = gamma * gamma / 4.;
+    theXsec += (sqrts < table->resonanceE0)
+                   ? amplitude * halfGamma2 / ((sqrts - table->resonanceE0) * (sqrts - table->resonanceE0) + halfGamma2)
+                   : amplitude;
+  }
+
+  //Beyond the table, the cross section at the energy of the particle is taken to bound the one below it
+  if (!inTable)
+    theXsec = std::max(theXsec, AnalyticCrossSectionPerNucleon(aParticle));
+  return theXsec;
+}
+
+void G4ProcessHelper::BuildCrossSectionTable(const G4ParticleDefinition* aParticle) {
+  CrossSectionTable& table = crossSectionTables[aParticle];
+  const CustomParticleRegistry::Entry* anEntry = particleRegistry.find(aParticle->GetPDGEncoding());
+  table.nonResonant.resize(kNBoostPoints);
+  for (int i = 0; i < kNBoostPoints; ++i)
+    table.nonResonant[i] = anEntry ? NonResonantCrossSection(*anEntry, std::exp(i * kLogBoostStep)) : 0.;
+  table.nonResonantMax.resize(kNBoostPoints);
+  G4double runningMax = table.nonResonant[0];
+  for (int i = 0; i < kNBoostPoints; ++i) {
+    runningMax = std::max(runningMax, table.nonResonant[std::min(i + 1, kNBoostPoints - 1)]);
+    table.nonResonantMax[i] = runningMax;
+  }
+
+  const double m = aParticle->GetPDGMass();
+  const double mp = theProton->GetPDGMass();
+  table.m2PlusMp2 = m * m + mp * mp;
+  table.resonanceE0 = std::sqrt(table.m2PlusMp2 + 2. * (ek_0 + m) * mp);
+}
+
+G4double G4ProcessHelper::ElementFactor(const G4Element* anElement) {
+  const size_t index = anElement->GetIndex();
+  if (index >= elementFactors.size())
+    elementFactors.resize(index + 1, -1.);
+  if (elementFactors[index] < 0.)
+    elementFactors[index] = pow(anElement->GetN(), 0.7) * 1.25;
+  return elementFactors[index];
+}
+
+void G4ProcessHelper::BuildMaterialData() {
+  for (const G4Material* aMaterial : *G4Material::GetMaterialTable())
+    GetMaterialData(aMaterial);
+  //The materials of the regions are updated before the physics tables are built
+  regionMaterialFactors.clear();
+}
+
+G4double G4ProcessHelper::RegionMaterialFactor(const G4Region* aRegion) {
+  const auto it = regionMaterialFactors.find(aRegion);
+  if (it != regionMaterialFactors.end())
+    return it->second;
+
+  G4double factor = 0;
+  auto material = aRegion->GetMaterialIterator();
+  for (size_t i = 0; i < aRegion->GetNumberOfMaterials(); i++, ++material)
+    factor = std::max(factor, MaterialFactor(*material));
+  regionMaterialFactors[aRegion] = factor;
+  return factor;
+}
+
+void G4ProcessHelper::FillMaterialData(const G4Material* aMaterial) {
+  const size_t index = aMaterial->GetIndex();
+  if (index >= materialData.size())
+    materialData.resize(index + 1, MaterialData{0., 0., false});
+
+  const G4ElementVector* theElementVector = aMaterial->GetElementVector();
+  const G4double* NbOfAtomsPerVolume = aMaterial->GetVecNbOfAtomsPerVolume();
+  G4double factor = 0;
+  G4double NumberOfProtons = 0;
+  G4double NumberOfNucleons = 0;
+  for (size_t elm = 0; elm < aMaterial->GetNumberOfElements(); elm++) {
+    factor += NbOfAtomsPerVolume[elm] * ElementFactor((*theElementVector)[elm]);
+    //Summing number of protons per unit volume
+    NumberOfProtons += NbOfAtomsPerVolume[elm] * (*theElementVector)[elm]->GetZ();
+    //Summing nucleons (not neutrons)
+    NumberOfNucleons += NbOfAtomsPerVolume[elm] * (*theElementVector)[elm]->GetN();
+  }
+
+  MaterialData& data = materialData[index];
+  data.crossSectionFactor = factor;
+  data.protonFraction = NumberOfProtons / NumberOfNucleons;
+  data.filled = true;
+}
+
+G4double G4ProcessHelper::NonResonantCrossSection(const CustomParticleRegistry::Entry& anEntry, double boost) {
   G4double theXsec = 0;
-  G4String name = aParticle->GetDefinition()->GetParticleName();
   if (!reggemodel) {
     //Flat cross section
-    if (CustomPDGParser::s_isRGlueball(thePDGCode)) {
+    if (anEntry.is(CustomParticleRegistry::kRGlueball)) {
       theXsec = 24 * millibarn;
     } else {
-      std::vector<G4int> nq = CustomPDGParser::s_containedQuarks(thePDGCode);
-      //    edm::LogInfo("SimG4CoreCustomPhysics")<<"Number of quarks: "<<nq.size()<<G4endl;
-      for (std::vector<G4int>::iterator it = nq.begin(); it != nq.end(); it++) {
-        //	  edm::LogInfo("SimG4CoreCustomPhysics")<<"Quarkvector: "<<*it<<G4endl;
-        if (*it == 1 || *it == 2)
-          theXsec += 12 * millibarn;
-        if (*it == 3)
-          theXsec += 6 * millibarn;
-      }
+      theXsec = (anEntry.quarks[0] + anEntry.quarks[1]) * 12 * millibarn + anEntry.quarks[2] * 6 * millibarn;
     }
   } else {  //reggemodel
     double R = Regge(boost);
     double P = Pom(boost);
-    if (thePDGCode > 0) {
-      if (CustomPDGParser::s_isMesonino(thePDGCode))
+    if (anEntry.definition->GetPDGEncoding() > 0) {
+      if (anEntry.is(CustomParticleRegistry::kMesonino))
         theXsec = (P + R) * millibarn;
-      if (CustomPDGParser::s_isSbaryon(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kSbaryon))
         theXsec = 2 * P * millibarn;
-      if (CustomPDGParser::s_isRMeson(thePDGCode) || CustomPDGParser::s_isRGlueball(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kRMeson | CustomParticleRegistry::kRGlueball))
         theXsec = (R + 2 * P) * millibarn;
-      if (CustomPDGParser::s_isRBaryon(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kRBaryon))
         theXsec = 3 * P * millibarn;
     } else {
-      if (CustomPDGParser::s_isMesonino(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kMesonino))
         theXsec = P * millibarn;
-      if (CustomPDGParser::s_isSbaryon(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kSbaryon))
         theXsec = (2 * (P + R) + 30 / sqrt(boost)) * millibarn;
-      if (CustomPDGParser::s_isRMeson(thePDGCode) || CustomPDGParser::s_isRGlueball(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kRMeson | CustomParticleRegistry::kRGlueball))
         theXsec = (R + 2 * P) * millibarn;
-      if (CustomPDGParser::s_isRBaryon(thePDGCode))
+      if (anEntry.is(CustomParticleRegistry::kRBaryon))
         theXsec = 3 * P * millibarn;
     }
   }
+  return theXsec;
+}
+
+G4double G4ProcessHelper::AnalyticCrossSectionPerNucleon(const G4DynamicParticle* aParticle) {
+  //We really do need a dedicated class to handle the cross sections. They might not always be constant
+  const CustomParticleRegistry::Entry* anEntry = particleRegistry.find(aParticle->GetDefinition()->GetPDGEncoding());
+  double boost = (aParticle->GetKineticEnergy() + aParticle->GetMass()) / aParticle->GetMass();
+  G4double theXsec = anEntry ? NonResonantCrossSection(*anEntry, boost) : 0.;
+
   //Adding resonance
   if (resonant) {
     double e_0 = ek_0 + aParticle->GetDefinition()->GetPDGMass();  //Now total energy
@@ -178,40 +354,122 @@ G4double G4ProcessHelper::GetInclusiveCrossSection(const G4DynamicParticle* aPar
     //      if(fabs(aParticle->GetKineticEnergy()/GeV-200)<10)  std::cout<<sqrts/GeV<<" "<<theXsec/millibarn<<std::endl;
   }
 
-  //  std::cout<<"Xsec/nucleon: "<<theXsec/millibarn<<"millibarn, Total Xsec: "<<theXsec * anElement->GetN()/millibarn<<" millibarn"<<std::endl;
-  return theXsec * pow(anElement->GetN(), 0.7) * 1.25;  // * 0.523598775598299;
+  return theXsec;
+}
+
+void G4ProcessHelper::CompileChannelTables(const ReactionMap& pReactionMap, const ReactionMap& nReactionMap) {
+  auto byThreshold = [](const ReactionChannel& a, const ReactionChannel& b) { return a.massSum < b.massSum; };
+
+  channelTables.assign(2 * particleRegistry.size(), ChannelTable());
+  const ReactionMap* reactionMaps[2] = {&pReactionMap, &nReactionMap};
+  for (int targetIndex = 0; targetIndex != 2; targetIndex++) {
+    for (const auto& reactions : *reactionMaps[targetIndex]) {
+      ChannelTable& table = channelTables[2 * particleRegistry.index(reactions.first) + targetIndex];
+      for (const ReactionProduct& aReaction : reactions.second) {
+        if (aReaction.empty())
+          continue;
+        ReactionChannel channel;
+        channel.products = aReaction;
+        channel.massSum = 0;
+        channel.givesBaryon = false;
+        for (G4int pdg : aReaction) {
+          const CustomParticleRegistry::Entry& product = *particleRegistry.find(pdg);
+          channel.massSum += product.mass;
+          if (product.is(CustomParticleRegistry::kSbaryon | CustomParticleRegistry::kRBaryon))
+            channel.givesBaryon = true;
+        }
+        channel.leadingCharge = particleRegistry.find(aReaction[0])->charge;
+
+        if (aReaction.size() != 2 && aReaction.size() != ReactionProduct::kMaxProducts)
+          G4cerr << "ReactionProduct has unsupported number of secondaries: " << aReaction.size() << G4endl;
+
+        table.all.push_back(channel);
+        (channel.givesBaryon ? table.baryonic : table.nonBaryonic).push_back(channel);
+      }
+      //stable_sort keeps the order of the process definitions among channels of equal threshold
+      for (auto* channels : {&table.all, &table.baryonic, &table.nonBaryonic})
+        std::stable_sort(channels->begin(), channels->end(), byThreshold);
+      if (!reggemodel)
+        BuildFlatModelBins(table, particleRegistry.find(reactions.first)->charge);
+    }
+  }
+}
+
+void G4ProcessHelper::BuildFlatModelBins(ChannelTable& table, G4double incidentCharge) {
+  const std::vector<ReactionChannel>& channels = table.all;
+  std::vector<G4double>& edges = table.sqrtsBinEdges;
+  edges.clear();
+  if (channels.empty())
+    return;
+
+  //Bin edges. Within a bin, sqrt(s) minus the threshold of any open channel changes by at most kBinRatio
+  for (size_t i = 0; i != channels.size(); i++) {
+    const G4double threshold = channels[i].massSum;
+    if (!edges.empty() && threshold <= edges.back())
+      continue;
+    G4double next = threshold + kLastBinOffset;
+    for (size_t j = i + 1; j != channels.size(); j++) {
+      if (channels[j].massSum > threshold) {
+        next = channels[j].massSum;
+        break;
+      }
+    }
+    edges.push_back(threshold);
+    for (G4double width = std::min(kFirstBinWidth, next - threshold); threshold + width < next; width *= kBinRatio)
+      edges.push_back(threshold + width);
+  }
+  //Open ended bin above the highest threshold
+  edges.push_back(channels.back().massSum + kLastBinOffset);
+
+  std::vector<ChannelAliasTable::Channel> open;
+  std::vector<G4double> weights;
+  for (size_t bin = 0; bin != edges.size(); bin++) {
+    //Thresholds are bin edges, so the same channels are open in the whole bin
+    const size_t nOpen = std::upper_bound(channels.begin(),
+                                          channels.end(),
+                                          edges[bin],
+                                          [](G4double value, const ReactionChannel& channel) {
+                                            return value < channel.massSum;
+                                          }) -
+                         channels.begin();
+    //The phase space factor grows with sqrt(s), so the weights are evaluated with its value at the upper edge of the
+    //bin, or its limit of 1 in the last bin, and GetFinalState accepts a 2 -> 3 channel with the ratio of its value at
+    //the actual sqrt(s) to that bound
+    open.clear();
+    for (size_t i = 0; i != nOpen; i++)
+      open.push_back({channels[i].products.size() == 2,
+                      AcceptanceBound(table, bin, channels[i]),
+                      channels[i].leadingCharge != incidentCharge});
+    ChannelAliasTable::channelWeights(open, 0.15, suppressionfactor, weights);
+    table.flatModel.addBin(weights);
+  }
 }
 
-ReactionProduct G4ProcessHelper::GetFinalState(const G4Track& aTrack, G4ParticleDefinition*& aTarget) {
+size_t G4ProcessHelper::OpenChannels(const std::vector<ReactionChannel>& channels, G4double sqrts) {
+  //A channel is open if sqrts exceeds its threshold
+  return std::lower_bound(channels.begin(),
+                          channels.end(),
+                          sqrts,
+                          [](const ReactionChannel& channel, G4double value) { return channel.massSum < value; }) -
+         channels.begin();
+}
+
+const ReactionProduct& G4ProcessHelper::GetFinalState(const G4Track& aTrack, G4ParticleDefinition*& aTarget) {
   const G4DynamicParticle* aDynamicParticle = aTrack.GetDynamicParticle();
 
   //-----------------------------------------------
   // Choose n / p as target
-  // and get ReactionProductList pointer
+  // and get the channel table
   //-----------------------------------------------
 
-  G4Material* aMaterial = aTrack.GetMaterial();
-  const G4ElementVector* theElementVector = aMaterial->GetElementVector();
-  const G4double* NbOfAtomsPerVolume = aMaterial->GetVecNbOfAtomsPerVolume();
-
-  G4double NumberOfProtons = 0;
-  G4double NumberOfNucleons = 0;
-
-  for (size_t elm = 0; elm < aMaterial->GetNumberOfElements(); elm++) {
-    //Summing number of protons per unit volume
-    NumberOfProtons += NbOfAtomsPerVolume[elm] * (*theElementVector)[elm]->GetZ();
-    //Summing nucleons (not neutrons)
-    NumberOfNucleons += NbOfAtomsPerVolume[elm] * (*theElementVector)[elm]->GetN();
-  }
-
-  if (G4UniformRand() < NumberOfProtons / NumberOfNucleons) {
-    theReactionMap = &pReactionMap;
-    theTarget = theProton;
+  G4int targetIndex;
+  if (G4UniformRand() < ProtonFraction(aTrack.GetMaterial())) {
+    aTarget = theProton;
+    targetIndex = 0;
   } else {
-    theReactionMap = &nReactionMap;
-    theTarget = theNeutron;
+    aTarget = theNeutron;
+    targetIndex = 1;
   }
-  aTarget = theTarget;
 
   G4int theIncidentPDG = aDynamicParticle->GetDefinition()->GetPDGEncoding();
 
@@ -228,142 +486,58 @@ ReactionProduct G4ProcessHelper::GetFinalState(const G4Track& aTrack, G4Particle
        CustomPDGParser::s_isRMeson(theIncidentPDG)))
     baryonise = true;
 
-  //Making a pointer directly to the ReactionProductList we are looking at. Makes life easier :-)
-  ReactionProductList* aReactionProductList = &((*theReactionMap)[theIncidentPDG]);
-
-  //-----------------------------------------------
-  // Count processes
-  // kinematic check
-  // compute number of 2 -> 2 and 2 -> 3 processes
-  //-----------------------------------------------
-
-  G4int N22 = 0;  //Number of 2 -> 2 processes
-  G4int N23 = 0;  //Number of 2 -> 3 processes. Couldn't think of more informative names
-
-  //This is the list to be populated
-  ReactionProductList theReactionProductList;
-  std::vector<bool> theChargeChangeList;
-
-  for (ReactionProductList::iterator prod_it = aReactionProductList->begin(); prod_it != aReactionProductList->end();
-       prod_it++) {
-    G4int secondaries = prod_it->size();
-    // If the reaction is not possible we will not consider it
-    if (ReactionIsPossible(*prod_it, aDynamicParticle) &&
-        (!reggemodel || (baryonise && ReactionGivesBaryon(*prod_it)) ||
-         (!baryonise && !ReactionGivesBaryon(*prod_it)) || (CustomPDGParser::s_isSbaryon(theIncidentPDG)) ||
-         (CustomPDGParser::s_isRBaryon(theIncidentPDG)))) {
-      // The reaction is possible. Let's store and count it
-      theReactionProductList.push_back(*prod_it);
-      if (secondaries == 2) {
-        N22++;
-      } else if (secondaries == 3) {
-        N23++;
-      } else {
-        G4cerr << "ReactionProduct has unsupported number of secondaries: " << secondaries << G4endl;
-      }
-    } /*else {
-      edm::LogInfo("SimG4CoreCustomPhysics")<<"There was an impossible process"<<G4endl;
-      }*/
-  }
-  //  edm::LogInfo("SimG4CoreCustomPhysics")<<"The size of the ReactionProductList is: "<<theReactionProductList.size()<<G4endl;
-
-  if (theReactionProductList.empty())
+  const int incidentIndex = particleRegistry.index(theIncidentPDG);
+  if (incidentIndex < 0)
     G4Exception("G4ProcessHelper",
                 "NoProcessPossible",
                 FatalException,
                 "GetFinalState: No process could be selected from the given list.");
+  const ChannelTable& table = channelTables[2 * incidentIndex + targetIndex];
 
-  // For the Regge model no phase space considerations. We pick a process at random
+  // sqrt(s)= sqrt(m_1^2 + m_2^2 + 2 E_1 m_2)
+  const G4double m_1 = aDynamicParticle->GetDefinition()->GetPDGMass();
+  const G4double m_2 = aTarget->GetPDGMass();
+  const G4double sqrts = sqrt(m_1 * m_1 + m_2 * (m_2 + 2 * aDynamicParticle->GetTotalEnergy()));
+
+  // For the Regge model no phase space considerations. We pick a possible process at random
   if (reggemodel) {
-    int n_rps = theReactionProductList.size();
-    int select = (int)(G4UniformRand() * n_rps);
+    const std::vector<ReactionChannel>* channels = &table.all;
+    if (!CustomPDGParser::s_isSbaryon(theIncidentPDG) && !CustomPDGParser::s_isRBaryon(theIncidentPDG))
+      channels = baryonise ? &table.baryonic : &table.nonBaryonic;
+    const size_t n_rps = OpenChannels(*channels, sqrts);
+    if (n_rps == 0)
+      G4Exception("G4ProcessHelper",
+                  "NoProcessPossible",
+                  FatalException,
+                  "GetFinalState: No process could be selected from the given list.");
+    const size_t select = std::min(static_cast<size_t>(G4UniformRand() * n_rps), n_rps - 1);
     //      G4cout<<"Possible: "<<n_rps<<", chosen: "<<select<<G4endl;
-    return theReactionProductList[select];
-  }
-
-  // Fill a probability map. Remember total probability
-  // 2->2 is 0.15*1/n_22 2->3 uses phase space
-  G4double p22 = 0.15;
-  G4double p23 = 1 - p22;  // :-)
-
-  std::vector<G4double> Probabilities;
-  std::vector<G4bool> TwotoThreeFlag;
-
-  G4double CumulatedProbability = 0;
-
-  // To each ReactionProduct we assign a cumulated probability and a flag
-  // discerning between 2 -> 2 and 2 -> 3
-  for (unsigned int i = 0; i != theReactionProductList.size(); i++) {
-    if (theReactionProductList[i].size() == 2) {
-      CumulatedProbability += p22 / N22;
-      TwotoThreeFlag.push_back(false);
-    } else {
-      CumulatedProbability += p23 / N23;
-      TwotoThreeFlag.push_back(true);
-    }
-    Probabilities.push_back(CumulatedProbability);
-    //    edm::LogInfo("SimG4CoreCustomPhysics")<<"Pushing back cumulated probability: "<<CumulatedProbability<<G4endl;
-  }
-
-  //Renormalising probabilities
-  //  edm::LogInfo("SimG4CoreCustomPhysics")<<"Probs: ";
-  for (std::vector<G4double>::iterator it = Probabilities.begin(); it != Probabilities.end(); it++) {
-    *it /= CumulatedProbability;
-    //      edm::LogInfo("SimG4CoreCustomPhysics")<<*it<<" ";
-  }
-  //  edm::LogInfo("SimG4CoreCustomPhysics")<<G4endl;
-
-  // Choosing ReactionProduct
-
-  G4bool selected = false;
-  G4int tries = 0;
-  //  ReactionProductList::iterator prod_it;
-
-  //Keep looping over the list until we have a choice, or until we have tried 100 times
-  unsigned int i;
-  while (!selected && tries < 100) {
-    i = 0;
-    G4double dice = G4UniformRand();
-    // edm::LogInfo("SimG4CoreCustomPhysics")<<"What's the dice?"<<dice<<G4endl;
-    while (dice > Probabilities[i] && i < theReactionProductList.size()) {
-      //      edm::LogInfo("SimG4CoreCustomPhysics")<<"i: "<<i<<G4endl;
-      i++;
-    }
-
-    //    edm::LogInfo("SimG4CoreCustomPhysics")<<"Chosen i: "<<i<<G4endl;
-
-    if (!TwotoThreeFlag[i]) {
-      // 2 -> 2 processes are chosen immediately
-      selected = true;
-    } else {
-      // 2 -> 3 processes require a phase space lookup
-      if (PhaseSpace(theReactionProductList[i], aDynamicParticle) > G4UniformRand())
-        selected = true;
-      //selected = true;
-    }
-    //    double suppressionfactor=0.5;
-    if (selected && particleTable->FindParticle(theReactionProductList[i][0])->GetPDGCharge() !=
-                        aDynamicParticle->GetDefinition()->GetPDGCharge()) {
-      /*
-	edm::LogInfo("SimG4CoreCustomPhysics")<<"Incoming particle "<<aDynamicParticle->GetDefinition()->GetParticleName()
-	      <<" has charge "<<aDynamicParticle->GetDefinition()->GetPDGCharge()<<G4endl;
-	edm::LogInfo("SimG4CoreCustomPhysics")<<"Suggested particle "<<particleTable->FindParticle(theReactionProductList[i][0])->GetParticleName()
-	      <<" has charge "<<particleTable->FindParticle(theReactionProductList[i][0])->GetPDGCharge()<<G4endl;
-	*/
-      if (G4UniformRand() < suppressionfactor)
-        selected = false;
-    }
-    tries++;
-    //    edm::LogInfo("SimG4CoreCustomPhysics")<<"Tries: "<<tries<<G4endl;
+    return (*channels)[select].products;
   }
-  if (tries >= 100)
-    G4cerr << "Could not select process!!!!" << G4endl;
 
-  //  edm::LogInfo("SimG4CoreCustomPhysics")<<"So far so good"<<G4endl;
-  //  edm::LogInfo("SimG4CoreCustomPhysics")<<"Sec's: "<<theReactionProductList[i].size()<<G4endl;
+  // The open channels are selected from the alias table of the sqrt(s) bin. 2 -> 2 processes together have a
+  // probability of 0.15, 2 -> 3 processes are weighted by phase space and charge changing processes are suppressed
+  const std::vector<G4double>& edges = table.sqrtsBinEdges;
+  const size_t bin = std::upper_bound(edges.begin(), edges.end(), sqrts) - edges.begin();
+  if (bin == 0)
+    G4Exception("G4ProcessHelper",
+                "NoProcessPossible",
+                FatalException,
+                "GetFinalState: No process could be selected from the given list.");
+  //A charge changing channel that suppressionfactor >= 1 excludes is only drawn in a bin where nothing can be accepted,
+  //which selects by the proposal probabilities as the rejection loop did once it gave up
+  const G4double incidentCharge = particleRegistry[incidentIndex].charge;
+  auto uniform = [] { return G4UniformRand(); };
+  auto ratio = [&](size_t i) -> G4double {
+    const ReactionChannel& proposal = table.all[i];
+    if (proposal.products.size() == 2 || (suppressionfactor >= 1 && proposal.leadingCharge != incidentCharge))
+      return 1;
+    return PhaseSpace(sqrts - proposal.massSum) / AcceptanceBound(table, bin - 1, proposal);
+  };
+  const ReactionChannel& channel = table.all[table.flatModel.sample(bin - 1, uniform, ratio)];
 
   //Updating checkfraction:
-  if (theReactionProductList[i].size() == 2) {
+  if (channel.products.size() == 2) {
     n_22++;
   } else {
     n_23++;
@@ -371,48 +545,16 @@ ReactionProduct G4ProcessHelper::GetFinalState(const G4Track& aTrack, G4Particle
 
   checkfraction = (1.0 * n_22) / (n_22 + n_23);
   //  edm::LogInfo("SimG4CoreCustomPhysics")<<"n_22: "<<n_22<<" n_23: "<<n_23<<" Checkfraction: "<<checkfraction<<G4endl;
-  //  edm::LogInfo("SimG4CoreCustomPhysics") <<"Biig number: "<<n_22+n_23<<G4endl;
   //Return the chosen ReactionProduct
-  return theReactionProductList[i];
-}
-
-G4double G4ProcessHelper::ReactionProductMass(const ReactionProduct& aReaction,
-                                              const G4DynamicParticle* aDynamicParticle) {
-  // Incident energy:
-  G4double E_incident = aDynamicParticle->GetTotalEnergy();
-  //edm::LogInfo("SimG4CoreCustomPhysics")<<"Total energy: "<<E_incident<<" Kinetic: "<<aDynamicParticle->GetKineticEnergy()<<G4endl;
-  // sqrt(s)= sqrt(m_1^2 + m_2^2 + 2 E_1 m_2)
-  G4double m_1 = aDynamicParticle->GetDefinition()->GetPDGMass();
-  G4double m_2 = theTarget->GetPDGMass();
-  //edm::LogInfo("SimG4CoreCustomPhysics")<<"M_R: "<<m_1/GeV<<" GeV, M_np: "<<m_2/GeV<<" GeV"<<G4endl;
-  G4double sqrts = sqrt(m_1 * m_1 + m_2 * (m_2 + 2 * E_incident));
-  //edm::LogInfo("SimG4CoreCustomPhysics")<<"sqrt(s) = "<<sqrts/GeV<<" GeV"<<G4endl;
-  // Sum of rest masses after reaction:
-  G4double M_after = 0;
-  for (ReactionProduct::const_iterator r_it = aReaction.begin(); r_it != aReaction.end(); r_it++) {
-    //edm::LogInfo("SimG4CoreCustomPhysics")<<"Mass contrib: "<<(particleTable->FindParticle(*r_it)->GetPDGMass())/MeV<<" MeV"<<G4endl;
-    M_after += particleTable->FindParticle(*r_it)->GetPDGMass();
-  }
-  //edm::LogInfo("SimG4CoreCustomPhysics")<<"Intending to return this ReactionProductMass: "<<(sqrts - M_after)/MeV<<" MeV"<<G4endl;
-  return sqrts - M_after;
-}
-
-G4bool G4ProcessHelper::ReactionIsPossible(const ReactionProduct& aReaction,
-                                           const G4DynamicParticle* aDynamicParticle) {
-  if (ReactionProductMass(aReaction, aDynamicParticle) > 0)
-    return true;
-  return false;
+  return channel.products;
 }
 
-G4bool G4ProcessHelper::ReactionGivesBaryon(const ReactionProduct& aReaction) {
-  for (ReactionProduct::const_iterator it = aReaction.begin(); it != aReaction.end(); it++)
-    if (CustomPDGParser::s_isSbaryon(*it) || CustomPDGParser::s_isRBaryon(*it))
-      return true;
-  return false;
+G4double G4ProcessHelper::AcceptanceBound(const ChannelTable& table, size_t bin, const ReactionChannel& channel) {
+  const std::vector<G4double>& edges = table.sqrtsBinEdges;
+  return bin + 1 < edges.size() ? PhaseSpace(edges[bin + 1] - channel.massSum) : 1.;
 }
 
-G4double G4ProcessHelper::PhaseSpace(const ReactionProduct& aReaction, const G4DynamicParticle* aDynamicParticle) {
-  G4double qValue = ReactionProductMass(aReaction, aDynamicParticle);
+G4double G4ProcessHelper::PhaseSpace(G4double qValue) {
   G4double phi = sqrt(1 + qValue / (2 * 0.139 * GeV)) * pow(qValue / (1.1 * GeV), 3. / 2.);
   return (phi / (1 + phi));
 }
@@ -0,0 +1,64 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronAsyncDecayService.h"
+
+#include "Pythia8/Pythia.h"
+
+#include <algorithm>
+
+RHadronAsyncDecayService::RHadronAsyncDecayService(std::vector<std::unique_ptr<Pythia8::Pythia>> engines,
+                                                   DecayFunction decayFunction)
+    : engines_(std::move(engines)), decayFunction_(std::move(decayFunction)), nextId_(0), stopping_(false) {
+  threads_.reserve(engines_.size());
+  for (auto& engine : engines_)
+    threads_.emplace_back(&RHadronAsyncDecayService::run, this, std::ref(*engine));
+}
+
+RHadronAsyncDecayService::~RHadronAsyncDecayService() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wakeUp_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+RHadronAsyncDecayService::Ticket RHadronAsyncDecayService::submit(int pdgId, double mass, int seed) {
+  Ticket ticket;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ticket.id = nextId_++;
+    queue_.push_back(Request{ticket.id, pdgId, mass, seed, std::promise<Decay>()});
+    ticket.decay = queue_.back().result.get_future();
+  }
+  wakeUp_.notify_one();
+  return ticket;
+}
+
+void RHadronAsyncDecayService::cancel(std::uint64_t id) {
+  // A request already taken by a helper thread is finished and its result discarded with the future
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = std::find_if(queue_.begin(), queue_.end(), [id](const Request& request) { return request.id == id; });
+  if (it != queue_.end())
+    queue_.erase(it);
+}
+
+void RHadronAsyncDecayService::run(Pythia8::Pythia& pythia) {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wakeUp_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      // Requests still queued at shutdown belong to tracks that never reached their decay; their futures are abandoned
+      if (stopping_)
+        return;
+      request = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    Decay decay;
+    pythia.rndm.init(request.seed);
+    if (!decayFunction_(pythia, request.pdgId, request.mass, decay))
+      decay.clear();
+    request.result.set_value(std::move(decay));
+  }
+}
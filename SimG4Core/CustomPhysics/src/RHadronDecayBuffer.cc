@@ -0,0 +1,123 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayBuffer.h"
+
+#include "CLHEP/Units/SystemOfUnits.h"
+
+#include <algorithm>
+#include <cmath>
+
+void RHadronDecayBuffer::grow() {
+  const std::size_t capacity = std::max<std::size_t>(64, 2 * pdgId_.size());
+  pdgId_.resize(capacity);
+  status_.resize(capacity);
+  decayed_.resize(capacity);
+  px_.resize(capacity);
+  py_.resize(capacity);
+  pz_.resize(capacity);
+  e_.resize(capacity);
+  dx_.resize(capacity);
+  dy_.resize(capacity);
+  dz_.resize(capacity);
+  dt_.resize(capacity);
+  xProd_.resize(capacity);
+  yProd_.resize(capacity);
+  zProd_.resize(capacity);
+  xDec_.resize(capacity);
+  yDec_.resize(capacity);
+  zDec_.resize(capacity);
+  tDec_.resize(capacity);
+}
+
+void RHadronDecayBuffer::add(int pdgId, int status, const double p[4], const double vProd[4], const double vDec[4]) {
+  add(pdgId, status, p[0], p[1], p[2], p[3], vProd[0], vProd[1], vProd[2], vProd[3], vDec[0], vDec[1], vDec[2], vDec[3]);
+}
+
+void RHadronDecayBuffer::add(int pdgId,
+                             int status,
+                             double px,
+                             double py,
+                             double pz,
+                             double e,
+                             double xProd,
+                             double yProd,
+                             double zProd,
+                             double tProd,
+                             double xDec,
+                             double yDec,
+                             double zDec,
+                             double tDec) {
+  if (size_ == pdgId_.size())
+    grow();
+  const std::size_t i = size_++;
+  pdgId_[i] = pdgId;
+  status_[i] = status;
+  decayed_[i] = status < 0;
+  px_[i] = px;
+  py_[i] = py;
+  pz_[i] = pz;
+  e_[i] = e;
+  dx_[i] = xProd;
+  dy_[i] = yProd;
+  dz_[i] = zProd;
+  dt_[i] = tProd;
+  xDec_[i] = xDec;
+  yDec_[i] = yDec;
+  zDec_[i] = zDec;
+  tDec_[i] = tDec;
+}
+
+void RHadronDecayBuffer::toLab(const G4ThreeVector& beta, const G4ThreeVector& origin) {
+  const std::size_t n = size_;
+
+  // Same Lorentz transformation as CLHEP::HepLorentzVector::boost, written out for whole arrays
+  const double bx = beta.x(), by = beta.y(), bz = beta.z();
+  const double b2 = bx * bx + by * by + bz * bz;
+  const double gamma = (b2 > 0.) ? 1. / std::sqrt(1. - b2) : 1.;
+  const double gamma2 = (b2 > 0.) ? (gamma - 1.) / b2 : 0.;
+  const double ox = origin.x(), oy = origin.y(), oz = origin.z();
+  constexpr double toMeV = CLHEP::GeV;
+
+  double* px = px_.data();
+  double* py = py_.data();
+  double* pz = pz_.data();
+  double* e = e_.data();
+  for (std::size_t i = 0; i < n; ++i) {
+    const double bp = bx * px[i] + by * py[i] + bz * pz[i];
+    const double f = gamma2 * bp + gamma * e[i];
+    px[i] = (px[i] + f * bx) * toMeV;
+    py[i] = (py[i] + f * by) * toMeV;
+    pz[i] = (pz[i] + f * bz) * toMeV;
+    e[i] = gamma * (e[i] + bp) * toMeV;
+  }
+
+  double* dx = dx_.data();
+  double* dy = dy_.data();
+  double* dz = dz_.data();
+  double* dt = dt_.data();
+  double* xProd = xProd_.data();
+  double* yProd = yProd_.data();
+  double* zProd = zProd_.data();
+  for (std::size_t i = 0; i < n; ++i) {
+    const double bp = bx * dx[i] + by * dy[i] + bz * dz[i];
+    const double f = gamma2 * bp + gamma * dt[i];
+    dx[i] += f * bx;
+    dy[i] += f * by;
+    dz[i] += f * bz;
+    dt[i] = gamma * (dt[i] + bp);
+    xProd[i] = ox + dx[i];
+    yProd[i] = oy + dy[i];
+    zProd[i] = oz + dz[i];
+  }
+
+  double* xDec = xDec_.data();
+  double* yDec = yDec_.data();
+  double* zDec = zDec_.data();
+  double* tDec = tDec_.data();
+  for (std::size_t i = 0; i < n; ++i) {
+    const double bp = bx * xDec[i] + by * yDec[i] + bz * zDec[i];
+    const double f = gamma2 * bp + gamma * tDec[i];
+    xDec[i] += ox + f * bx;
+    yDec[i] += oy + f * by;
+    zDec[i] += oz + f * bz;
+    tDec[i] = gamma * (tDec[i] + bp);
+  }
+}
@@ -0,0 +1,71 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayContainment.h"
+
+#include "G4Box.hh"
+#include "G4GeometryTolerance.hh"
+#include "G4VSolid.hh"
+
+#include <algorithm>
+#include <cmath>
+
+RHadronDecayContainment::RHadronDecayContainment(double envelopeRadius, double envelopeHalfLength)
+    : world_(nullptr),
+      envelopeRadius2_(envelopeRadius > 0. ? envelopeRadius * envelopeRadius : 0.),
+      envelopeHalfLength_(envelopeHalfLength > 0. ? envelopeHalfLength : 0.) {}
+
+void RHadronDecayContainment::setWorld(const G4VSolid* world) {
+  world_ = world;
+  const double tolerance = G4GeometryTolerance::GetInstance()->GetSurfaceTolerance();
+  const G4ThreeVector margin(tolerance, tolerance, tolerance);
+
+  G4ThreeVector pMin, pMax;
+  world->BoundingLimits(pMin, pMax);
+  outerMin_ = pMin - margin;
+  outerMax_ = pMax + margin;
+
+  if (dynamic_cast<const G4Box*>(world)) {
+    // The bounding box of a box is exact
+    innerMin_ = pMin + margin;
+    innerMax_ = pMax - margin;
+  } else {
+    // Otherwise use the cube inscribed in the largest sphere around the origin that fits in the world
+    const G4ThreeVector origin;
+    const double safety = (world->Inside(origin) == kInside) ? world->DistanceToOut(origin) : 0.;
+    const double halfSide = std::max(0., safety - tolerance) / std::sqrt(3.);
+    innerMin_ = G4ThreeVector(-halfSide, -halfSide, -halfSide);
+    innerMax_ = G4ThreeVector(halfSide, halfSide, halfSide);
+  }
+}
+
+void RHadronDecayContainment::evaluate(const double* x,
+                                       const double* y,
+                                       const double* z,
+                                       const unsigned char* needed,
+                                       std::size_t n,
+                                       std::vector<unsigned char>& contained) const {
+  contained.resize(n);
+  unsigned char* state = contained.data();
+
+  // Branch-free pass over all points, settling everything except the points near the world boundary
+  const double oxMin = outerMin_.x(), oyMin = outerMin_.y(), ozMin = outerMin_.z();
+  const double oxMax = outerMax_.x(), oyMax = outerMax_.y(), ozMax = outerMax_.z();
+  const double ixMin = innerMin_.x(), iyMin = innerMin_.y(), izMin = innerMin_.z();
+  const double ixMax = innerMax_.x(), iyMax = innerMax_.y(), izMax = innerMax_.z();
+  const double r2Max = envelopeRadius2_;
+  const double zMax = envelopeHalfLength_;
+  const bool hasEnvelope = r2Max > 0. && zMax > 0.;
+  for (std::size_t i = 0; i < n; ++i) {
+    const bool inEnvelope = !hasEnvelope || ((x[i] * x[i] + y[i] * y[i] <= r2Max) & (std::abs(z[i]) <= zMax));
+    const bool inOuter = (x[i] >= oxMin) & (x[i] <= oxMax) & (y[i] >= oyMin) & (y[i] <= oyMax) & (z[i] >= ozMin) &
+                         (z[i] <= ozMax);
+    const bool inInner = (x[i] > ixMin) & (x[i] < ixMax) & (y[i] > iyMin) & (y[i] < iyMax) & (z[i] > izMin) &
+                         (z[i] < izMax);
+    const bool isNeeded = !needed || needed[i];
+    state[i] = (isNeeded & inEnvelope & inOuter) ? (inInner ? kContained : kAmbiguous) : kNotContained;
+  }
+
+  // Exact test near the boundary
+  for (std::size_t i = 0; i < n; ++i) {
+    if (state[i] == kAmbiguous)
+      state[i] = (world_->Inside(G4ThreeVector(x[i], y[i], z[i])) != kOutside) ? kContained : kNotContained;
+  }
+}
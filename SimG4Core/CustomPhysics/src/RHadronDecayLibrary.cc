@@ -0,0 +1,160 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayLibrary.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronInputHash.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RHadronDecayLibrary::~RHadronDecayLibrary() { close(); }
+
+uint64_t RHadronDecayLibrary::inputHash(const std::string& slhaFile, const std::vector<std::string>& commands) {
+  uint64_t salt;
+  std::memcpy(&salt, kMagic, sizeof(salt));
+  return rhadron::inputHash(salt ^ kVersion, slhaFile, commands);
+}
+
+bool RHadronDecayLibrary::write(const std::string& fileName, uint64_t inputHash, const DecayMap& decays) {
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.nSpecies = decays.size();
+  header.inputHash = inputHash;
+  header.nDecays = 0;
+  header.nProducts = 0;
+
+  std::vector<Species> species;
+  std::vector<Decay> decayTable;
+  std::vector<Product> products;
+  species.reserve(decays.size());
+
+  // std::map keeps the species sorted by pdgId, as required for the lookup in findSpecies
+  for (const auto& speciesDecays : decays) {
+    Species entry;
+    entry.pdgId = speciesDecays.first;
+    entry.nDecays = speciesDecays.second.size();
+    entry.firstDecay = decayTable.size();
+    species.push_back(entry);
+    for (const auto& decay : speciesDecays.second) {
+      Decay decayEntry;
+      decayEntry.firstProduct = products.size();
+      decayEntry.nProducts = decay.size();
+      decayTable.push_back(decayEntry);
+      products.insert(products.end(), decay.begin(), decay.end());
+    }
+  }
+  header.nDecays = decayTable.size();
+  header.nProducts = products.size();
+
+  const std::string tmpFileName = fileName + ".tmp." + std::to_string(::getpid());
+  std::ofstream out(tmpFileName, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    edm::LogError("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: Could not open " << tmpFileName << " for writing.";
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  out.write(reinterpret_cast<const char*>(species.data()), species.size() * sizeof(Species));
+  out.write(reinterpret_cast<const char*>(decayTable.data()), decayTable.size() * sizeof(Decay));
+  out.write(reinterpret_cast<const char*>(products.data()), products.size() * sizeof(Product));
+  out.close();
+  if (!out || std::rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+    edm::LogError("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: Failed to write " << fileName;
+    std::remove(tmpFileName.c_str());
+    return false;
+  }
+
+  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: Wrote " << header.nDecays << " decays of "
+                                             << header.nSpecies << " R-hadron species to " << fileName;
+  return true;
+}
+
+bool RHadronDecayLibrary::open(const std::string& fileName, uint64_t expectedHash) {
+  close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat fileStat;
+  if (::fstat(fd, &fileStat) != 0 || static_cast<std::size_t>(fileStat.st_size) < sizeof(Header)) {
+    ::close(fd);
+    return false;
+  }
+
+  mappedSize_ = fileStat.st_size;
+  mapped_ = ::mmap(nullptr, mappedSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped_ == MAP_FAILED) {
+    mapped_ = nullptr;
+    mappedSize_ = 0;
+    return false;
+  }
+
+  const char* base = static_cast<const char*>(mapped_);
+  const Header* header = reinterpret_cast<const Header*>(base);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: " << fileName
+                                              << " is not a decay library of version " << kVersion;
+    close();
+    return false;
+  }
+  if (header->inputHash != expectedHash) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: " << fileName
+                                              << " was built from a different SLHA file or command file.";
+    close();
+    return false;
+  }
+
+  const std::size_t expectedSize = sizeof(Header) + header->nSpecies * sizeof(Species) +
+                                   header->nDecays * sizeof(Decay) + header->nProducts * sizeof(Product);
+  if (expectedSize != mappedSize_) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronDecayLibrary: " << fileName << " is truncated or corrupted.";
+    close();
+    return false;
+  }
+
+  header_ = header;
+  species_ = reinterpret_cast<const Species*>(base + sizeof(Header));
+  decays_ = reinterpret_cast<const Decay*>(species_ + header->nSpecies);
+  products_ = reinterpret_cast<const Product*>(decays_ + header->nDecays);
+  return true;
+}
+
+std::pair<const RHadronDecayLibrary::Product*, const RHadronDecayLibrary::Product*> RHadronDecayLibrary::sample(
+    int pdgId, double u) const {
+  const Species* species = findSpecies(pdgId);
+  if (!species || species->nDecays == 0)
+    return std::make_pair(nullptr, nullptr);
+
+  const uint32_t index = std::min<uint32_t>(u * species->nDecays, species->nDecays - 1);
+  const Decay& decay = decays_[species->firstDecay + index];
+  const Product* first = products_ + decay.firstProduct;
+  return std::make_pair(first, first + decay.nProducts);
+}
+
+const RHadronDecayLibrary::Species* RHadronDecayLibrary::findSpecies(int pdgId) const {
+  if (!header_)
+    return nullptr;
+  const Species* end = species_ + header_->nSpecies;
+  const Species* it =
+      std::lower_bound(species_, end, pdgId, [](const Species& species, int id) { return species.pdgId < id; });
+  return (it != end && it->pdgId == pdgId) ? it : nullptr;
+}
+
+void RHadronDecayLibrary::close() {
+  if (mapped_)
+    ::munmap(mapped_, mappedSize_);
+  mapped_ = nullptr;
+  mappedSize_ = 0;
+  header_ = nullptr;
+  species_ = nullptr;
+  decays_ = nullptr;
+  products_ = nullptr;
+}
@@ -0,0 +1,233 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayRecordSink.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "G4Threading.hh"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+  // The sink of the job. It is deleted by finish(); a sink that was never finished is reported at the end of the
+  // process and left to it, since its queue cannot be written out safely during static destruction
+  struct Registry {
+    G4Mutex mutex = G4MUTEX_INITIALIZER;
+    RHadronDecayRecordSink* sink = nullptr;
+    std::string fileName;
+    bool finished = false;
+
+    ~Registry() {
+      if (sink)
+        std::cerr << "RHadronDecayRecordSink: " << fileName
+                  << " was never finished, its last row group is missing. Is the RHDecayRecordPublisher watcher "
+                     "configured in g4SimHits.Watchers?"
+                  << std::endl;
+    }
+  };
+
+  Registry& registry() {
+    static Registry reg;
+    return reg;
+  }
+}  // namespace
+
+void RHadronDecayRecordSink::configure(const std::string& fileName, unsigned int eventsPerRowGroup) {
+  if (fileName.empty())
+    return;
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  if (!reg.sink && !reg.finished) {
+    reg.sink = new RHadronDecayRecordSink(fileName, eventsPerRowGroup);
+    reg.fileName = fileName;
+  }
+  G4MUTEXUNLOCK(&reg.mutex);
+}
+
+void RHadronDecayRecordSink::record(const edm::EventID& eventID,
+                                    const RHadronPythiaDecayDataManager::DecayRecords& decays) {
+  if (decays.empty())
+    return;
+  // The sink is only deleted by the last publisher, once no other publisher records any more
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  RHadronDecayRecordSink* sink = reg.sink;
+  G4MUTEXUNLOCK(&reg.mutex);
+  if (sink)
+    sink->push(eventID, decays);
+}
+
+void RHadronDecayRecordSink::finish() {
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  reg.finished = true;
+  RHadronDecayRecordSink* sink = reg.sink;
+  reg.sink = nullptr;
+  G4MUTEXUNLOCK(&reg.mutex);
+  delete sink;
+}
+
+RHadronDecayRecordSink::RHadronDecayRecordSink(const std::string& fileName, unsigned int eventsPerRowGroup)
+    : fileName_(fileName),
+      eventsPerRowGroup_(std::max(1u, eventsPerRowGroup)),
+      out_(fileName, std::ios::binary | std::ios::trunc),
+      stopping_(false),
+      rowGroupEvents_(0) {
+  if (out_.is_open()) {
+    out_.write("RHDR", 4);
+    out_.write(reinterpret_cast<const char*>(&kVersion), sizeof(kVersion));
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronDecayRecordSink: Writing R-hadron decay records to " << fileName_;
+  } else {
+    edm::LogWarning("SimG4CoreCustomPhysics")
+        << "RHadronDecayRecordSink: Could not open " << fileName_ << " for writing. No decay records will be written.";
+  }
+  writer_ = std::thread(&RHadronDecayRecordSink::run, this);
+}
+
+RHadronDecayRecordSink::~RHadronDecayRecordSink() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  notEmpty_.notify_one();
+  writer_.join();
+}
+
+void RHadronDecayRecordSink::push(const edm::EventID& eventID,
+                                  const RHadronPythiaDecayDataManager::DecayRecords& decays) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notFull_.wait(lock, [this] { return queue_.size() < kQueueBatches; });
+    if (spare_.empty()) {
+      queue_.emplace_back();
+    } else {
+      queue_.push_back(std::move(spare_.back()));
+      spare_.pop_back();
+    }
+    // Copying into a reused batch keeps its capacity
+    queue_.back().eventID = eventID;
+    queue_.back().decays = decays;
+  }
+  notEmpty_.notify_one();
+}
+
+void RHadronDecayRecordSink::run() {
+  while (true) {
+    Batch batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      notEmpty_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      // Unlike the asynchronous decay service, everything queued at shutdown is still written
+      if (queue_.empty())
+        break;
+      batch = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    notFull_.notify_one();
+
+    append(batch);
+    if (rowGroupEvents_ >= eventsPerRowGroup_)
+      writeRowGroup();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    spare_.push_back(std::move(batch));
+  }
+  if (rowGroupEvents_ > 0)
+    writeRowGroup();
+}
+
+void RHadronDecayRecordSink::append(const Batch& batch) {
+  const auto& decays = batch.decays;
+  ++rowGroupEvents_;
+  for (std::size_t i = 0; i < decays.size(); ++i) {
+    const auto& parent = decays.parents[i];
+    run_.push_back(batch.eventID.run());
+    luminosityBlock_.push_back(batch.eventID.luminosityBlock());
+    event_.push_back(batch.eventID.event());
+    trackID_.push_back(parent.trackID);
+    pdgID_.push_back(parent.pdgID);
+    px_.push_back(parent.px);
+    py_.push_back(parent.py);
+    pz_.push_back(parent.pz);
+    energy_.push_back(parent.energy);
+    x_.push_back(parent.x);
+    y_.push_back(parent.y);
+    z_.push_back(parent.z);
+    time_.push_back(parent.time);
+    nDaughters_.push_back(decays.daughtersEnd(i) - decays.daughtersBegin(i));
+  }
+  for (const auto& daughter : decays.daughters) {
+    dTrackID_.push_back(daughter.trackID);
+    dPdgID_.push_back(decays.pdgCodes[daughter.pdgIndex]);
+    dPx_.push_back(daughter.px);
+    dPy_.push_back(daughter.py);
+    dPz_.push_back(daughter.pz);
+    dEnergy_.push_back(daughter.energy);
+    dX_.push_back(daughter.dx);
+    dY_.push_back(daughter.dy);
+    dZ_.push_back(daughter.dz);
+    dT_.push_back(daughter.dt);
+  }
+}
+
+template <typename T>
+void RHadronDecayRecordSink::writeColumn(const std::vector<T>& column) {
+  const uLong rawSize = column.size() * sizeof(T);
+  uLongf compressedSize = compressBound(rawSize);
+  compressed_.resize(compressedSize);
+  if (compress2(compressed_.data(), &compressedSize, reinterpret_cast<const Bytef*>(column.data()), rawSize, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    out_.setstate(std::ios::failbit);
+    return;
+  }
+  const std::uint32_t sizes[2] = {static_cast<std::uint32_t>(compressedSize), static_cast<std::uint32_t>(rawSize)};
+  out_.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+  out_.write(reinterpret_cast<const char*>(compressed_.data()), compressedSize);
+}
+
+void RHadronDecayRecordSink::writeRowGroup() {
+  if (out_.good()) {
+    const std::uint32_t counts[2] = {static_cast<std::uint32_t>(trackID_.size()), static_cast<std::uint32_t>(dTrackID_.size())};
+    out_.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+    writeColumn(run_);
+    writeColumn(luminosityBlock_);
+    writeColumn(event_);
+    writeColumn(trackID_);
+    writeColumn(pdgID_);
+    writeColumn(px_);
+    writeColumn(py_);
+    writeColumn(pz_);
+    writeColumn(energy_);
+    writeColumn(x_);
+    writeColumn(y_);
+    writeColumn(z_);
+    writeColumn(time_);
+    writeColumn(nDaughters_);
+    writeColumn(dTrackID_);
+    writeColumn(dPdgID_);
+    writeColumn(dPx_);
+    writeColumn(dPy_);
+    writeColumn(dPz_);
+    writeColumn(dEnergy_);
+    writeColumn(dX_);
+    writeColumn(dY_);
+    writeColumn(dZ_);
+    writeColumn(dT_);
+    out_.flush();
+    if (!out_.good())
+      edm::LogWarning("SimG4CoreCustomPhysics")
+          << "RHadronDecayRecordSink: Failed to write " << fileName_ << ". No further decay records will be written.";
+  }
+
+  // Dropped silently when the file is not writable, the warning was given once
+  rowGroupEvents_ = 0;
+  for (auto* column : {&run_, &luminosityBlock_, &nDaughters_})
+    column->clear();
+  event_.clear();
+  for (auto* column : {&trackID_, &pdgID_, &dTrackID_, &dPdgID_})
+    column->clear();
+  for (auto* column : {&px_, &py_, &pz_, &energy_, &x_, &y_, &z_, &time_})
+    column->clear();
+  for (auto* column : {&dPx_, &dPy_, &dPz_, &dEnergy_, &dX_, &dY_, &dZ_, &dT_})
+    column->clear();
+}
@@ -0,0 +1,142 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayStats.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "G4Threading.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+  const char* const kStageNames[RHadronDecayStats::kNStages] = {
+      "fillParticle", "RHadronToConstituents", "pythiaNext", "conversion", "librarySample", "phaseSpace", "hadronLevel", "asyncWait"};
+  const char* const kCounterNames[RHadronDecayStats::kNCounters] = {
+      "decays", "libraryDecays", "fastDecays", "asyncDecays", "products", "droppedOutsideWorld", "unknownPdgId", "nextFailures"};
+
+  // Process-wide merged accumulators of the decayers already destroyed, and the decayers still alive
+  struct Registry {
+    G4Mutex mutex = G4MUTEX_INITIALIZER;
+    std::string reportFile;
+    bool written = false;
+    std::vector<const std::unordered_map<int, RHadronDecayStats::Species>*> live;
+    std::map<int, RHadronDecayStats::Species> merged;
+
+    // Only reports the missing end-of-job hook; writing the report this late is not safe
+    ~Registry() {
+      if (!reportFile.empty() && !written)
+        std::cerr << "RHadronDecayStats: The decay timing report " << reportFile
+                  << " was never written. Is the RHDecayRecordPublisher watcher configured in g4SimHits.Watchers?"
+                  << std::endl;
+    }
+
+    void merge(const std::unordered_map<int, RHadronDecayStats::Species>& species) {
+      for (const auto& entry : species)
+        merged[entry.first].merge(entry.second);
+    }
+
+    void write() const {
+      const std::string tmpFileName = reportFile + ".tmp." + std::to_string(::getpid());
+      std::ofstream out(tmpFileName, std::ios::trunc);
+      if (!out.is_open()) {
+        edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronDecayStats: Could not open " << tmpFileName << " for writing.";
+        return;
+      }
+      out << "{\n  \"species\": [";
+      bool firstSpecies = true;
+      for (const auto& entry : merged) {
+        const RHadronDecayStats::Species& species = entry.second;
+        out << (firstSpecies ? "\n" : ",\n") << "    {\n      \"pdgId\": " << entry.first;
+        firstSpecies = false;
+        for (int c = 0; c < RHadronDecayStats::kNCounters; ++c)
+          out << ",\n      \"" << kCounterNames[c] << "\": " << species.counters[c];
+        out << ",\n      \"stages\": {";
+        for (int s = 0; s < RHadronDecayStats::kNStages; ++s) {
+          uint64_t calls = 0;
+          int lastBin = 0;
+          for (int b = 0; b < RHadronDecayStats::kNBins; ++b) {
+            calls += species.histogram[s][b];
+            if (species.histogram[s][b] > 0)
+              lastBin = b;
+          }
+          out << (s == 0 ? "\n" : ",\n") << "        \"" << kStageNames[s] << "\": {\"calls\": " << calls
+              << ", \"totalNs\": " << species.totalNs[s] << ", \"log2NsHistogram\": [";
+          for (int b = 0; b <= lastBin; ++b)
+            out << (b == 0 ? "" : ", ") << species.histogram[s][b];
+          out << "]}";
+        }
+        out << "\n      }\n    }";
+      }
+      out << "\n  ]\n}\n";
+      out.close();
+      if (!out || std::rename(tmpFileName.c_str(), reportFile.c_str()) != 0) {
+        edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronDecayStats: Failed to write " << reportFile;
+        std::remove(tmpFileName.c_str());
+      }
+    }
+  };
+
+  Registry& registry() {
+    static Registry instance;
+    return instance;
+  }
+}  // namespace
+
+void RHadronDecayStats::Species::merge(const Species& other) {
+  for (int c = 0; c < kNCounters; ++c)
+    counters[c] += other.counters[c];
+  for (int s = 0; s < kNStages; ++s) {
+    totalNs[s] += other.totalNs[s];
+    for (int b = 0; b < kNBins; ++b)
+      histogram[s][b] += other.histogram[s][b];
+  }
+}
+
+RHadronDecayStats::RHadronDecayStats(const std::string& reportFile) : enabled_(!reportFile.empty()) {
+  if (!enabled_)
+    return;
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  if (reg.reportFile.empty()) {
+    reg.reportFile = reportFile;
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronDecayStats: Writing R-hadron decay timing report to " << reportFile;
+  }
+  reg.live.push_back(&species_);
+  G4MUTEXUNLOCK(&reg.mutex);
+}
+
+RHadronDecayStats::~RHadronDecayStats() {
+  if (!enabled_)
+    return;
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), &species_), reg.live.end());
+  reg.merge(species_);
+  G4MUTEXUNLOCK(&reg.mutex);
+}
+
+void RHadronDecayStats::writeReport() {
+  Registry& reg = registry();
+  G4MUTEXLOCK(&reg.mutex);
+  if (!reg.reportFile.empty() && !reg.written) {
+    for (const auto* species : reg.live)
+      reg.merge(*species);
+    reg.write();
+    reg.written = true;
+  }
+  G4MUTEXUNLOCK(&reg.mutex);
+}
+
+void RHadronDecayStats::record(Species& species, Stage stage, std::chrono::steady_clock::duration duration) {
+  const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  int bin = 0;
+  for (uint64_t value = ns; value > 1 && bin < kNBins - 1; value >>= 1)
+    ++bin;
+  species.totalNs[stage] += ns;
+  ++species.histogram[stage][bin];
+}
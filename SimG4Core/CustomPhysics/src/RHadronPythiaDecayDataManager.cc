@@ -0,0 +1,135 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayDataManager.h"
+
+#include "G4Event.hh"
+#include "G4EventManager.hh"
+
+#include <algorithm>
+
+G4ThreadLocal std::shared_ptr<RHadronPythiaDecayDataManager::EventRecord> RHadronPythiaDecayDataManager::currentRecord_;
+
+using DecayRecords = RHadronPythiaDecayDataManager::DecayRecords;
+using TrackData = RHadronPythiaDecayDataManager::TrackData;
+
+std::uint16_t DecayRecords::pdgIndex(int pdgCode) {
+  // A decay produces few species, so a linear search over the codes seen so far is enough
+  const auto it = std::find(pdgCodes.begin(), pdgCodes.end(), pdgCode);
+  if (it != pdgCodes.end())
+    return static_cast<std::uint16_t>(it - pdgCodes.begin());
+  pdgCodes.push_back(pdgCode);
+  return static_cast<std::uint16_t>(pdgCodes.size() - 1);
+}
+
+void DecayRecords::addDaughter(const G4Track& track) {
+  const TrackData& parent = parents.back();
+  const G4ThreeVector momentum = track.GetMomentum();
+  const G4ThreeVector& position = track.GetPosition();
+  PackedDaughter daughter;
+  daughter.trackID = track.GetTrackID();
+  daughter.pdgIndex = pdgIndex(track.GetDefinition()->GetPDGEncoding());
+  daughter.px = static_cast<float>(momentum.x());
+  daughter.py = static_cast<float>(momentum.y());
+  daughter.pz = static_cast<float>(momentum.z());
+  daughter.energy = static_cast<float>(track.GetTotalEnergy());
+  daughter.dx = static_cast<float>(position.x() - parent.x);
+  daughter.dy = static_cast<float>(position.y() - parent.y);
+  daughter.dz = static_cast<float>(position.z() - parent.z);
+  daughter.dt = static_cast<float>(track.GetGlobalTime() - parent.time);
+  daughters.push_back(daughter);
+}
+
+TrackData DecayRecords::daughter(std::size_t i, std::size_t j) const {
+  const TrackData& parent = parents[i];
+  const PackedDaughter& packed = daughters[j];
+  TrackData data;
+  data.trackID = packed.trackID;
+  data.pdgID = pdgCodes[packed.pdgIndex];
+  data.px = packed.px;
+  data.py = packed.py;
+  data.pz = packed.pz;
+  data.energy = packed.energy;
+  data.x = parent.x + packed.dx;
+  data.y = parent.y + packed.dy;
+  data.z = parent.z + packed.dz;
+  data.time = parent.time + packed.dt;
+  return data;
+}
+
+std::shared_ptr<RHadronPythiaDecayDataManager::EventRecord> RHadronPythiaDecayDataManager::beginEvent() {
+  auto record = std::make_shared<EventRecord>(G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID());
+  {
+    std::lock_guard<std::mutex> lock(registryMutex_);
+    if (!spareDecays_.empty()) {
+      // Reuse the capacity of buffers handed back by the consumer
+      std::swap(record->decays, spareDecays_.back());
+      spareDecays_.pop_back();
+    }
+  }
+  currentRecord_ = record;
+  return record;
+}
+
+RHadronPythiaDecayDataManager::EventRecord& RHadronPythiaDecayDataManager::recordForCurrentEvent() {
+  // Without RHDecayRecordPublisher the record is opened by the first decay of the event, replacing that of the last event
+  const int eventID = G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID();
+  if (!currentRecord_ || currentRecord_->g4EventID != eventID)
+    beginEvent();
+  return *currentRecord_;
+}
+
+void RHadronPythiaDecayDataManager::addDecayParent(const G4Track& aTrack) {
+  recordForCurrentEvent().decays.addParent(aTrack);
+}
+
+void RHadronPythiaDecayDataManager::addDecayDaughter(const G4Track& aTrack) {
+  // Always follows addDecayParent on the same thread and in the same event
+  currentRecord_->decays.addDaughter(aTrack);
+}
+
+void RHadronPythiaDecayDataManager::registerPublisher() {
+  publishers_.fetch_add(1, std::memory_order_acq_rel);
+  publisherRegistered_.store(true, std::memory_order_release);
+}
+
+bool RHadronPythiaDecayDataManager::unregisterPublisher() {
+  return publishers_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+void RHadronPythiaDecayDataManager::publish(const std::shared_ptr<EventRecord>& record, const edm::EventID& eventID) {
+  // The simulation of the event is finished, so the thread no longer appends to the record
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  record->eventID = eventID;
+  records_.push_back(record);
+}
+
+void RHadronPythiaDecayDataManager::drop(const std::shared_ptr<EventRecord>& record) {
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  const auto it = std::find(records_.begin(), records_.end(), record);
+  if (it == records_.end())
+    return;
+  records_.erase(it);
+  recycle(*record);
+}
+
+void RHadronPythiaDecayDataManager::recycle(EventRecord& record) {
+  if (record.decays.daughters.capacity() > 0) {
+    record.decays.clear();
+    spareDecays_.push_back(std::move(record.decays));
+  }
+}
+
+void RHadronPythiaDecayDataManager::getDecayInfo(const edm::EventID& eventID, DecayRecords& decays) {
+  decays.clear();
+
+  // An event is simulated by a single thread, so it has at most one record
+  std::lock_guard<std::mutex> lock(registryMutex_);
+  const auto it = std::find_if(
+      records_.begin(), records_.end(), [&eventID](const auto& record) { return record->eventID == eventID; });
+  if (it == records_.end())
+    return;
+  std::shared_ptr<EventRecord> record = std::move(*it);
+  records_.erase(it);
+
+  // After the swap the record holds the previous, cleared buffers of the consumer
+  std::swap(decays, record->decays);
+  recycle(*record);
+}
@@ -1,55 +1,84 @@
 #include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayer.h"
 #include "SimG4Core/CustomPhysics/interface/RHadronPythiaDecayDataManager.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayLibrary.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayRecordSink.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronFlavourTable.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronInputHash.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronPythiaInitCache.h"
 
 #include "CLHEP/Vector/LorentzVector.h"
 #include "G4Track.hh"
 #include "G4DynamicParticle.hh"
 #include "G4Step.hh"
 #include "G4DecayProducts.hh"
+#include "G4DecayTable.hh"
+#include "G4VDecayChannel.hh"
 #include "G4VParticleChange.hh"
 #include "G4ParticleDefinition.hh"
 #include "G4ParticleTable.hh"
 #include "G4TransportationManager.hh"
+#include "G4EventManager.hh"
+#include "G4Event.hh"
 
 #include "Pythia8/Pythia.h"
 #include "Pythia8/RHadrons.h"
+#include "GeneratorInterface/Pythia8Interface/interface/P8RndmEngine.h"
+#include "FWCore/ParameterSet/interface/FileInPath.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "Randomize.hh"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <fstream>
 
-static inline unsigned short int nth_digit(const int& val,const unsigned short& n) { return (std::abs(val)/(int(std::pow(10,n-1))))%10;}
+G4ThreadLocal std::unique_ptr<Pythia8::Pythia> RHadronPythiaDecayer::pythia_;
+G4ThreadLocal gen::P8RndmEnginePtr RHadronPythiaDecayer::p8RndmEngine_;
+std::unique_ptr<RHadronPythiaInitCache> RHadronPythiaDecayer::initCache_;
+G4Mutex RHadronPythiaDecayer::initCacheMutex_ = G4MUTEX_INITIALIZER;
 
 RHadronPythiaDecayer::RHadronPythiaDecayer(edm::ParameterSet const& p)
- : pythia_(new Pythia8::Pythia())
+  : libraryUnavailable_(false),
+    asyncDecayThreads_(p.getUntrackedParameter<unsigned int>("RhadronAsyncDecayThreads", 0)),
+    pendingPdgId_(0),
+    containment_(p.getUntrackedParameter<double>("RhadronDecayAcceptanceRadius", 0.), p.getUntrackedParameter<double>("RhadronDecayAcceptanceHalfLength", 0.)),
+    stats_(p.getUntrackedParameter<std::string>("RhadronDecayTimingReportFile", "")),
+    sparticleIds_{1000021, 1000006, 1000005}
 {
-  std::string SLHAParticleDefinitionsFile = p.getParameter<edm::FileInPath>("particlesDef").fullPath();
+  slhaFile_ = p.getParameter<edm::FileInPath>("particlesDef").fullPath();
   std::string commandFile = p.getParameter<edm::FileInPath>("RhadronPythiaDecayerCommandFile").fullPath();
+  initCacheFile_ = p.getUntrackedParameter<std::string>("RhadronPythiaInitCacheFile", "");
+  libraryFile_ = p.getUntrackedParameter<std::string>("RhadronDecayLibraryFile", "");
+  libraryDecaysPerSpecies_ = p.getUntrackedParameter<unsigned int>("RhadronDecayLibraryDecaysPerSpecies", 10000);
+  // The decays recorded for RHDecayTracer are also streamed to this file when RHDecayRecordPublisher publishes them
+  RHadronDecayRecordSink::configure(p.getUntrackedParameter<std::string>("RhadronDecayRecordFile", ""), p.getUntrackedParameter<unsigned int>("RhadronDecayRecordEventsPerRowGroup", 1000));
 
-  // Initialize the Pythia8 instance for R-hadron decays
-  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Initializing Pythia8 instance for R-hadron decays.";
+  // Enough for the usual 10-40 products of a decay, so the buffer is not regrown during the first decays
+  secondaryDisplacements_.reserve(64);
+
+  // The Pythia8 instances themselves are created lazily, one per Geant4 worker thread, the first time a decay happens on that thread.
+  // Here only the settings are collected so that every thread initializes its instance identically.
+  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Collecting Pythia8 settings for R-hadron decays.";
 
   // Read in the SLHA particle definitions file if provided
-  if (SLHAParticleDefinitionsFile.empty()) {
+  if (slhaFile_.empty()) {
     edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: No SLHA particle definitions file provided. Using default Pythia8 settings.";
   }
   else {
-    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Using SLHA particle definitions file: " << SLHAParticleDefinitionsFile;
-    pythia_->readString("SLHA:file = " + SLHAParticleDefinitionsFile);
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Using SLHA particle definitions file: " << slhaFile_;
   }
 
   // Read in the command file for Pythia8 settings. If none is given use the following default settings.
   if (commandFile.empty()) {
     edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: No command file provided. Using default RHadronPythiaDecayer settings.";
-    pythia_->readString("ProcessLevel:all = off");
-    pythia_->readString("SUSY:all = on");
-    pythia_->readString("RHadrons:allow = off");
-    pythia_->readString("1000021:mWidth = 1000.0"); // Force gluino to decay immediately
-    pythia_->readString("1000006:mWidth = 1000.0"); // Force stop to decay immediately
-    pythia_->readString("RHadrons:probGluinoball = 0.1");
-    pythia_->readString("PartonLevel:FSR = off");
+    pythiaCommands_ = {"ProcessLevel:all = off",
+                       "SUSY:all = on",
+                       "RHadrons:allow = off",
+                       "1000021:mWidth = 1000.0", // Force gluino to decay immediately
+                       "1000006:mWidth = 1000.0", // Force stop to decay immediately
+                       "RHadrons:probGluinoball = 0.1",
+                       "PartonLevel:FSR = off"};
   } 
   else {
     edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Using command file: " << commandFile;
@@ -59,13 +88,32 @@ RHadronPythiaDecayer::RHadronPythiaDecayer(edm::ParameterSet const& p)
       edm::LogError("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Could not open command file: " << commandFile;
     }
     while(getline(command_stream, line)){
-      pythia_->readString(line);
+      pythiaCommands_.push_back(line);
       edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Pythia8 command: " << line;
     }
     command_stream.close();
   }
 
-  pythia_->init();
+  if (asyncDecayThreads_ > 0 && libraryFile_.empty()) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Decaying R-hadrons with " << asyncDecayThreads_ << " helper threads per Geant4 thread while they are transported.";
+  }
+
+  fastDecayIds_ = p.getUntrackedParameter<std::vector<int>>("RhadronFastDecayPdgIds", std::vector<int>());
+  for (auto& id : fastDecayIds_) id = std::abs(id);
+  std::sort(fastDecayIds_.begin(), fastDecayIds_.end());
+  if (!fastDecayIds_.empty()) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Using the fast phase space decay with the SLHA branching ratios for " << fastDecayIds_.size() << " R-hadron species.";
+  }
+
+  const double acceptanceRadius = p.getUntrackedParameter<double>("RhadronDecayAcceptanceRadius", 0.);
+  const double acceptanceHalfLength = p.getUntrackedParameter<double>("RhadronDecayAcceptanceHalfLength", 0.);
+  if (acceptanceRadius > 0. && acceptanceHalfLength > 0.) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Dropping decay products outside of the cylinder r < " << acceptanceRadius << " mm, |z| < " << acceptanceHalfLength << " mm";
+  }
+
+  if (!libraryFile_.empty()) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Sampling R-hadron decays from the decay library " << libraryFile_;
+  }
 }
 
 
@@ -74,6 +122,78 @@ RHadronPythiaDecayer::~RHadronPythiaDecayer() {
 }
 
 
+Pythia8::Pythia* RHadronPythiaDecayer::pythia() {
+  if (!pythia_) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Initializing Pythia8 instance for R-hadron decays on thread " << G4Threading::G4GetThreadId();
+    p8RndmEngine_ = std::make_shared<gen::P8RndmEngine>();
+    p8RndmEngine_->setRandomEngine(G4Random::getTheEngine());
+    pythia_ = createPythia({}, p8RndmEngine_);
+  }
+
+  // G4Random is pointed at the RandomNumberGeneratorService engine of the stream currently simulated on this thread,
+  // so each stream draws its decays from its own reproducible sequence
+  p8RndmEngine_->setRandomEngine(G4Random::getTheEngine());
+  return pythia_.get();
+}
+
+
+std::unique_ptr<Pythia8::Pythia> RHadronPythiaDecayer::createPythia(const std::vector<std::string>& extraCommands, const gen::P8RndmEnginePtr& rndmEngine) {
+  // The first instance of the job is initialized from the SLHA file and the commands, or restored from the cache file of an earlier job.
+  // Its Settings and ParticleData are kept so that all later instances skip the parsing of the XML databases and of the SLHA file.
+  // Other threads wait here while the first instance is initialized.
+  std::unique_ptr<Pythia8::Pythia> pythia;
+  G4MUTEXLOCK(&initCacheMutex_);
+  if (!initCache_) {
+    initCache_ = std::make_unique<RHadronPythiaInitCache>(initCacheFile_, slhaFile_, pythiaCommands_);
+    initCache_->load();
+  }
+  if (!initCache_->isLoaded()) {
+    pythia = std::make_unique<Pythia8::Pythia>();
+    if (rndmEngine) pythia->setRndmEnginePtr(rndmEngine);
+    for (const auto& command : extraCommands) {
+      pythia->readString(command);
+    }
+    initPythia(*pythia);
+    // Extra commands are specific to this instance and must not leak into the snapshot
+    if (extraCommands.empty()) initCache_->capture(*pythia);
+    G4MUTEXUNLOCK(&initCacheMutex_);
+    return pythia;
+  }
+  pythia = initCache_->restore();
+  G4MUTEXUNLOCK(&initCacheMutex_);
+
+  if (rndmEngine) pythia->setRndmEnginePtr(rndmEngine);
+  for (const auto& command : extraCommands) {
+    pythia->readString(command);
+  }
+  if (!pythia->init()) {
+    edm::LogError("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Pythia8 initialization from the init snapshot failed.";
+  }
+  readRHadronSettings(*pythia);
+  return pythia;
+}
+
+
+void RHadronPythiaDecayer::initPythia(Pythia8::Pythia& pythia) {
+  if (!slhaFile_.empty()) pythia.readString("SLHA:file = " + slhaFile_);
+  for (const auto& command : pythiaCommands_) {
+    pythia.readString(command);
+  }
+  if (!pythia.init()) {
+    edm::LogError("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Pythia8 initialization failed.";
+  }
+  readRHadronSettings(pythia);
+}
+
+
+void RHadronPythiaDecayer::readRHadronSettings(const Pythia8::Pythia& pythia) {
+  // Read the sparticle ids once here rather than looking the settings up by name on every decay
+  sparticleIds_.gluino = pythia.settings.mode("RHadrons:idGluino");
+  sparticleIds_.stop = pythia.settings.mode("RHadrons:idStop");
+  sparticleIds_.sbottom = pythia.settings.mode("RHadrons:idSbottom");
+}
+
+
 G4VParticleChange* RHadronPythiaDecayer::DecayIt(const G4Track& aTrack, const G4Step& aStep) {
   // First, clear the secondary displacements and call the standard DecayIt to generate secondaries
   secondaryDisplacements_.clear();
@@ -93,88 +213,414 @@ G4VParticleChange* RHadronPythiaDecayer::DecayIt(const G4Track& aTrack, const G4
 }
 
 
+void RHadronPythiaDecayer::StartTracking(G4Track* aTrack) {
+  // G4Decay only declares StartTracking() without argument, which hides the G4VProcess version called by the tracking
+  G4VProcess::StartTracking(aTrack);
+  if (asyncDecayThreads_ == 0 || !libraryFile_.empty()) return;
+
+  if (!asyncService_) {
+    // The helper instances are restored from the init snapshot here, on the Geant4 thread. The helper threads only touch
+    // their own instance and a copy of the sparticle ids, which are set once the first instance is initialized
+    std::vector<std::unique_ptr<Pythia8::Pythia>> engines;
+    for (unsigned int i = 0; i < asyncDecayThreads_; ++i) {
+      engines.push_back(createPythia({}, nullptr));
+    }
+    asyncService_ = std::make_unique<RHadronAsyncDecayService>(std::move(engines), [ids = sparticleIds_](Pythia8::Pythia& pythia, int pdgId, double mass, RHadronAsyncDecayService::Decay& decay) {
+      return restFrameDecay(pythia, ids, pdgId, mass, decay);
+    });
+  }
+
+  // The decay at rest does not depend on where or with which momentum the R-hadron will decay, so it can start now.
+  // The track is transported and decayed by Geant4 exactly as without the service; only the products come from the helper
+  pendingPdgId_ = aTrack->GetDefinition()->GetPDGEncoding();
+  pendingDecay_ = asyncService_->submit(pendingPdgId_, aTrack->GetDynamicParticle()->GetMass() / CLHEP::GeV, requestSeed(*aTrack));
+}
+
+
+void RHadronPythiaDecayer::EndTracking() {
+  G4Decay::EndTracking();
+  // R-hadrons leaving the world or interacting never collect their decay. A request still queued is cancelled, one already
+  // started is finished by the helper thread and discarded
+  if (pendingDecay_.decay.valid()) {
+    asyncService_->cancel(pendingDecay_.id);
+    pendingDecay_.decay = std::future<RHadronAsyncDecayService::Decay>();
+  }
+}
+
+
+int RHadronPythiaDecayer::requestSeed(const G4Track& aTrack) {
+  // Hash of the event, the track and its initial kinematics instead of a number drawn from the random engine of the stream:
+  // requests that are never collected leave the stream, and so the rest of the event, unchanged
+  const int eventID = G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID();
+  const int trackID = aTrack.GetTrackID();
+  const G4ThreeVector momentum = aTrack.GetMomentum();
+  const double kinematics[4] = {momentum.x(), momentum.y(), momentum.z(), aTrack.GetGlobalTime()};
+  uint64_t hash = rhadron::fnv1a(rhadron::kFnvOffset, &eventID, sizeof(eventID));
+  hash = rhadron::fnv1a(hash, &trackID, sizeof(trackID));
+  hash = rhadron::fnv1a(hash, kinematics, sizeof(kinematics));
+  return static_cast<int>(hash % 900000000);
+}
+
+
 G4DecayProducts* RHadronPythiaDecayer::ImportDecayProducts(const G4Track& aTrack){
   // Initialize decay products. These will be used inside of G4Decay::DecayIt()
   G4DecayProducts * dp = new G4DecayProducts();
   dp->SetParentParticle( *(aTrack.GetDynamicParticle()) );
-  std::vector<G4DynamicParticle*> particles;
 
-  // Use Pythia8 to decay the particle and add them to the particles vector
-  pythiaDecay(aTrack, particles);
-
-  // Add the particles to the decay products
-  for (unsigned int i=0; i<particles.size(); ++i){
-    if (particles[i]) dp->PushProducts(particles[i]);
-  }
+  // Sample the decay from the library if there is one, or collect the decay computed while the R-hadron was transported, or use the fast decay for
+  // the species selected for it, otherwise use Pythia8 to decay the particle.
+  // Products are pushed directly into the decay products
+  bool decayed = !libraryFile_.empty() && libraryDecay(aTrack, *dp);
+  if (!decayed && pendingDecay_.decay.valid()) decayed = asyncDecay(aTrack, *dp);
+  if (!decayed && std::binary_search(fastDecayIds_.begin(), fastDecayIds_.end(), std::abs(aTrack.GetDefinition()->GetPDGEncoding())))
+    decayed = fastDecay(aTrack, *dp);
+  if (!decayed) pythiaDecay(aTrack, *dp);
 
   return dp;
 }
 
 
-void RHadronPythiaDecayer::pythiaDecay(const G4Track& aTrack, std::vector<G4DynamicParticle*> & particles)
+void RHadronPythiaDecayer::prepareContainment()
+{
+  // The geometry is closed before the first decay and does not change during the job
+  if (containment_.hasWorld()) return;
+  G4VPhysicalVolume* worldPhys = G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume();
+  containment_.setWorld(worldPhys->GetLogicalVolume()->GetSolid());
+}
+
+
+void RHadronPythiaDecayer::pythiaDecay(const G4Track& aTrack, G4DecayProducts& products)
 {
   // Initialize the Pythia8 event where the decay will happen
-  Pythia8::Event& event = pythia_->event;
+  Pythia8::Pythia* pythia = this->pythia();
+  Pythia8::Event& event = pythia->event;
+
+  RHadronDecayStats::Species* stats = stats_.species(aTrack.GetDefinition()->GetPDGEncoding());
+  RHadronDecayStats::count(stats, RHadronDecayStats::kDecays);
 
-  // Store the decay location and world volume to later check if decay products are inside the world volume
-  G4ThreeVector RHadronDecayLocation = aTrack.GetPosition();
-  G4VPhysicalVolume* worldPhys = G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume();
-  G4VSolid* worldSolid = worldPhys->GetLogicalVolume()->GetSolid();
-  
   // Fill the event with the Rhadron, strip it down to its constituents, i.e. gluino and quarks for a gluino R-hadron. Then finally let pythia handle the rest
-  fillParticle(aTrack, event);
-  RHadronToConstituents(event);
-  pythia_->next();
+  {
+    RHadronDecayStats::Timer timer(stats, RHadronDecayStats::kFillParticle);
+    fillParticle(aTrack, event);
+  }
+  {
+    RHadronDecayStats::Timer timer(stats, RHadronDecayStats::kToConstituents);
+    RHadronToConstituents(*pythia, sparticleIds_);
+  }
+  {
+    RHadronDecayStats::Timer timer(stats, RHadronDecayStats::kPythiaNext);
+    if (!pythia->next()) RHadronDecayStats::count(stats, RHadronDecayStats::kNextFailures);
+  }
+
+  convertEvent(aTrack, event, products, stats);
+}
 
-  // Add the particles from the Pythia event into the Geant particle vector
+
+void RHadronPythiaDecayer::convertEvent(const G4Track& aTrack, Pythia8::Event& event, G4DecayProducts& products, RHadronDecayStats::Species* stats)
+{
+  RHadronDecayStats::Timer conversionTimer(stats, RHadronDecayStats::kConversion);
+
+  // The Pythia event is already in the lab frame
+  decayBuffer_.clear();
+  for(int i=0; i<event.size(); i++){
+    decayBuffer_.add(event[i].id(), event[i].status(), event[i].px(), event[i].py(), event[i].pz(), event[i].e(),
+                     event[i].xProd(), event[i].yProd(), event[i].zProd(), event[i].tProd(),
+                     event[i].xDec(), event[i].yDec(), event[i].zDec(), event[i].tDec());
+  }
+  addBufferedProducts(aTrack, G4ThreeVector(), products, stats);
+}
+
+
+void RHadronPythiaDecayer::addBufferedProducts(const G4Track& aTrack, const G4ThreeVector& beta, G4DecayProducts& products, RHadronDecayStats::Species* stats)
+{
+  // Boost, convert to MeV and place all products at the decay location, then test all production vertices and the decay vertices of decayed products
+  prepareContainment();
+  decayBuffer_.toLab(beta, aTrack.GetPosition());
+  const std::size_t n = decayBuffer_.size();
+  containment_.evaluate(decayBuffer_.xProd(), decayBuffer_.yProd(), decayBuffer_.zProd(), nullptr, n, prodContained_);
+  containment_.evaluate(decayBuffer_.xDec(), decayBuffer_.yDec(), decayBuffer_.zDec(), decayBuffer_.decayed(), n, decContained_);
+
+  // Add the particles into the Geant decay products
   G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
-  for(int i=0; i<pythia_->event.size(); i++){
-    // If the particle status is negative and it decays outside of the vertex, change the status to positive and do not add its decay products. If its status is negative but it decays inside the detector, skip it.
-    G4ThreeVector vProd = RHadronDecayLocation + G4ThreeVector(pythia_->event[i].xProd(), pythia_->event[i].yProd(), pythia_->event[i].zProd());
-    G4ThreeVector vDec = RHadronDecayLocation + G4ThreeVector(pythia_->event[i].xDec(), pythia_->event[i].yDec(), pythia_->event[i].zDec());
-    if (pythia_->event[i].status() < 0 && (worldSolid->Inside(vDec) == kOutside)) pythia_->event[i].statusPos();
-    else if (pythia_->event[i].status() < 0) continue;
-    if (worldSolid->Inside(vProd) == kOutside) continue;
-
-    G4ThreeVector displacement(pythia_->event[i].xProd(), pythia_->event[i].yProd(), pythia_->event[i].zProd());
-    G4LorentzVector p4(pythia_->event[i].px(), pythia_->event[i].py(), pythia_->event[i].pz(), pythia_->event[i].e());
-    p4 *= 1000.0; // Convert GeV to MeV
-
-    const G4ParticleDefinition* particleDefinition = particleTable->FindParticle(pythia_->event[i].id()); // Get the particle definition from the Pythia event
+  for (std::size_t i = 0; i < n; ++i) {
+    // If the particle has decayed but its decay vertex is outside of the world, treat it as final and do not add its decay products. If it decays inside the world, skip it.
+    if (decayBuffer_.status(i) < 0 && decContained_[i]) continue;
+    if (!prodContained_[i]) {
+      RHadronDecayStats::count(stats, RHadronDecayStats::kDroppedOutsideWorld);
+      continue;
+    }
+
+    const G4ParticleDefinition* particleDefinition = particleTable->FindParticle(decayBuffer_.pdgId(i));
     if (!particleDefinition){
-      edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: I don't know a definition for pdgid " << pythia_->event[i].id() << "! Skipping it...";
+      edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: I don't know a definition for pdgid " << decayBuffer_.pdgId(i) << "! Skipping it...";
+      RHadronDecayStats::count(stats, RHadronDecayStats::kUnknownPdgId);
       continue;
     }
 
-    G4DynamicParticle* dynamicParticle = new G4DynamicParticle(particleDefinition, p4); // Create the dynamic particle and add it to Geant
-    particles.push_back(dynamicParticle);
-    secondaryDisplacements_.push_back(displacement); // Store the position of the secondary particle to update in RHadronPythiaDecayer::DecayIt
+    products.PushProducts(new G4DynamicParticle(particleDefinition, decayBuffer_.p4(i))); // Create the dynamic particle and add it to Geant. G4DynamicParticle comes from the thread-local G4Allocator pool
+    secondaryDisplacements_.push_back(decayBuffer_.displacement(i)); // Store the position of the secondary particle to update in RHadronPythiaDecayer::DecayIt
+    RHadronDecayStats::count(stats, RHadronDecayStats::kProducts);
   }
 }
 
 
-void RHadronPythiaDecayer::fillParticle(const G4Track& aTrack, Pythia8::Event& event) const
+bool RHadronPythiaDecayer::fastDecay(const G4Track& aTrack, G4DecayProducts& products)
 {
-  // Reset event record to allow for new event.
-  event.reset();
+  Pythia8::Pythia* pythia = this->pythia();
+  Pythia8::Event& event = pythia->event;
+  Pythia8::ParticleData& pdt = pythia->particleData;
+
+  RHadronDecayStats::Species* stats = stats_.species(aTrack.GetDefinition()->GetPDGEncoding());
+  // The stages are timed into scratch accumulators, kept only if the fast decay succeeds. Otherwise pythiaDecay fills
+  // and splits the R-hadron again and times it itself
+  RHadronDecayStats::Species* fastStats = stats_.scratch();
+
+  // Strip the R-hadron to its constituents as for a Pythia8 decay. The sparticle is always the entry after the R-hadron
+  {
+    RHadronDecayStats::Timer timer(fastStats, RHadronDecayStats::kFillParticle);
+    fillParticle(aTrack, event);
+  }
+  {
+    RHadronDecayStats::Timer timer(fastStats, RHadronDecayStats::kToConstituents);
+    RHadronToConstituents(*pythia, sparticleIds_);
+  }
+  const int iSparticle = 2;
+  if (event.size() <= iSparticle || event[1].status() > 0) return false;
+
+  // Decay the sparticle in its rest frame with the decay table read from the SLHA file by CustomParticleFactory
+  const G4ParticleDefinition* sparticleDefinition = G4ParticleTable::GetParticleTable()->FindParticle(event[iSparticle].id());
+  G4DecayTable* decayTable = sparticleDefinition ? sparticleDefinition->GetDecayTable() : nullptr;
+  if (!decayTable) return false;
+  const double sparticleMass = event[iSparticle].m() * CLHEP::GeV;
+  G4VDecayChannel* channel = decayTable->SelectADecayChannel(sparticleMass);
+  if (!channel) return false;
+  std::unique_ptr<G4DecayProducts> sparticleDecay;
+  {
+    RHadronDecayStats::Timer timer(fastStats, RHadronDecayStats::kPhaseSpace);
+    sparticleDecay.reset(channel->DecayIt(sparticleMass));
+  }
+  if (!sparticleDecay) return false;
+
+  // Colour flow of a decay into a singlet plus a (anti)quark, a quark-antiquark pair or a gluon. Anything else,
+  // and products which Pythia8 would still decay as resonances (t, W, Z, h), is left to the full Pythia8 decay
+  int col = event[iSparticle].col();
+  int acol = event[iSparticle].acol();
+  const Pythia8::Vec4 sparticleP = event[iSparticle].p();
+  const Pythia8::Vec4 vertex = event[iSparticle].vProd();
+  const int iFirst = event.size();
+  for (G4int k = 0; k < sparticleDecay->entries(); ++k) {
+    const G4DynamicParticle* daughter = (*sparticleDecay)[k];
+    const int id = daughter->GetPDGcode();
+    if (pdt.isResonance(id)) return false;
+    int daughterCol = 0;
+    int daughterAcol = 0;
+    switch (pdt.colType(id)) {
+      case 0:
+        break;
+      case 1:
+        if (col == 0) return false;
+        std::swap(daughterCol, col);
+        break;
+      case -1:
+        if (acol == 0) return false;
+        std::swap(daughterAcol, acol);
+        break;
+      case 2:
+        if (col == 0 || acol == 0) return false;
+        std::swap(daughterCol, col);
+        std::swap(daughterAcol, acol);
+        break;
+      default:
+        return false;
+    }
+    const G4LorentzVector p4 = daughter->Get4Momentum() / CLHEP::GeV;
+    Pythia8::Vec4 p(p4.px(), p4.py(), p4.pz(), p4.e());
+    p.bst(sparticleP);
+    const int iDaughter = event.append(id, 23, iSparticle, 0, 0, 0, daughterCol, daughterAcol, p, daughter->GetMass() / CLHEP::GeV);
+    event[iDaughter].vProd(vertex);
+  }
+  if (col != 0 || acol != 0) return false;
+  event[iSparticle].statusNeg();
+  event[iSparticle].daughters(iFirst, event.size() - 1);
+
+  // Only fragment the colour singlet system of the decay products and the spectators, and decay the hadrons
+  {
+    RHadronDecayStats::Timer timer(fastStats, RHadronDecayStats::kHadronLevel);
+    if (!pythia->forceHadronLevel(false)) {
+      RHadronDecayStats::count(stats, RHadronDecayStats::kNextFailures);
+      return false;
+    }
+  }
+
+  if (stats) stats->merge(*fastStats);
+  RHadronDecayStats::count(stats, RHadronDecayStats::kDecays);
+  RHadronDecayStats::count(stats, RHadronDecayStats::kFastDecays);
+  convertEvent(aTrack, event, products, stats);
+  return true;
+}
+
+
+bool RHadronPythiaDecayer::libraryDecay(const G4Track& aTrack, G4DecayProducts& products)
+{
+  if (libraryUnavailable_) return false;
+  if (!library_) {
+    library_ = std::make_unique<RHadronDecayLibrary>();
+    if (!library_->open(libraryFile_, RHadronDecayLibrary::inputHash(slhaFile_, pythiaCommands_))) {
+      edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Could not use the decay library " << libraryFile_ << ". Decaying R-hadrons with Pythia8 instead.";
+      libraryUnavailable_ = true;
+      return false;
+    }
+  }
+
+  const int pdgId = aTrack.GetDefinition()->GetPDGEncoding();
+  RHadronDecayStats::Species* stats = stats_.species(pdgId);
+  std::pair<const RHadronDecayLibrary::Product*, const RHadronDecayLibrary::Product*> decay;
+  {
+    RHadronDecayStats::Timer timer(stats, RHadronDecayStats::kLibrarySample);
+    decay = library_->sample(pdgId, G4UniformRand());
+  }
+  if (decay.first == decay.second) return false;
+  RHadronDecayStats::count(stats, RHadronDecayStats::kDecays);
+  RHadronDecayStats::count(stats, RHadronDecayStats::kLibraryDecays);
+  convertRestFrameDecay(aTrack, decay.first, decay.second, products, stats);
+  return true;
+}
+
+
+bool RHadronPythiaDecayer::asyncDecay(const G4Track& aTrack, G4DecayProducts& products)
+{
+  const int pdgId = aTrack.GetDefinition()->GetPDGEncoding();
+  RHadronDecayStats::Species* stats = stats_.species(pdgId);
+  RHadronAsyncDecayService::Decay decay;
+  {
+    // Only waits if the R-hadron decays before the helper thread finished its decay
+    RHadronDecayStats::Timer timer(stats, RHadronDecayStats::kAsyncWait);
+    decay = pendingDecay_.decay.get();
+  }
+  if (pdgId != pendingPdgId_ || decay.empty()) return false;
+  RHadronDecayStats::count(stats, RHadronDecayStats::kDecays);
+  RHadronDecayStats::count(stats, RHadronDecayStats::kAsyncDecays);
+  convertRestFrameDecay(aTrack, decay.data(), decay.data() + decay.size(), products, stats);
+  return true;
+}
+
+
+void RHadronPythiaDecayer::convertRestFrameDecay(const G4Track& aTrack, const RHadronDecayLibrary::Product* first, const RHadronDecayLibrary::Product* last, G4DecayProducts& products, RHadronDecayStats::Species* stats)
+{
+  RHadronDecayStats::Timer conversionTimer(stats, RHadronDecayStats::kConversion);
+
+  decayBuffer_.clear();
+  for (const RHadronDecayLibrary::Product* product = first; product != last; ++product) {
+    decayBuffer_.add(product->pdgId, product->status, product->p, product->vProd, product->vDec);
+  }
+
+  // Boost from the R-hadron rest frame to the lab frame. Vertices are boosted as space-time 4-vectors
+  addBufferedProducts(aTrack, aTrack.GetDynamicParticle()->Get4Momentum().boostVector(), products, stats);
+}
+
+
+void RHadronPythiaDecayer::buildDecayLibrary(const std::vector<int>& pdgIds)
+{
+  if (libraryFile_.empty() || pdgIds.empty()) return;
+
+  // Keep an existing library if it was built from the same inputs and covers all species
+  const uint64_t hash = RHadronDecayLibrary::inputHash(slhaFile_, pythiaCommands_);
+  {
+    RHadronDecayLibrary existing;
+    if (existing.open(libraryFile_, hash) &&
+        std::all_of(pdgIds.begin(), pdgIds.end(), [&existing](int pdgId) { return existing.hasSpecies(pdgId); })) {
+      edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Decay library " << libraryFile_ << " is up to date.";
+      return;
+    }
+  }
+
+  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: Building decay library " << libraryFile_ << " with "
+                                             << libraryDecaysPerSpecies_ << " decays for each of " << pdgIds.size() << " R-hadrons.";
+
+  // A dedicated instance seeded from the input hash, so the library only depends on the SLHA file and the commands
+  std::unique_ptr<Pythia8::Pythia> libraryPythia = createPythia({"Random:setSeed = on", "Random:seed = " + std::to_string(hash % 900000000)}, nullptr);
+  Pythia8::Pythia& pythia = *libraryPythia;
+
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  RHadronDecayLibrary::DecayMap decays;
+  for (int pdgId : pdgIds) {
+    const G4ParticleDefinition* particleDefinition = particleTable->FindParticle(pdgId);
+    if (!particleDefinition) continue;
+    const double mass = particleDefinition->GetPDGMass() / CLHEP::GeV;
+
+    std::vector<std::vector<RHadronDecayLibrary::Product>>& speciesDecays = decays[pdgId];
+    speciesDecays.reserve(libraryDecaysPerSpecies_);
+    unsigned int nFailures = 0;
+    while (speciesDecays.size() < libraryDecaysPerSpecies_ && nFailures < libraryDecaysPerSpecies_) {
+      std::vector<RHadronDecayLibrary::Product> products;
+      if (!restFrameDecay(pythia, sparticleIds_, pdgId, mass, products)) {
+        ++nFailures;
+        continue;
+      }
+      speciesDecays.push_back(std::move(products));
+    }
+    if (nFailures > 0) {
+      edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer: " << nFailures << " Pythia8 failures while building the decay library for pdgid " << pdgId;
+    }
+  }
+
+  RHadronDecayLibrary::write(libraryFile_, hash, decays);
+}
+
 
+bool RHadronPythiaDecayer::restFrameDecay(Pythia8::Pythia& pythia, const SparticleIds& ids, int pdgId, double mass, std::vector<RHadronDecayLibrary::Product>& products)
+{
+  Pythia8::Event& event = pythia.event;
+  fillParticle(pdgId, mass, Pythia8::Vec4(0., 0., 0., mass), event);
+  RHadronToConstituents(pythia, ids);
+  if (!pythia.next()) return false;
+
+  // Keep final state particles, and decayed particles with a displaced decay vertex which may decay outside of the world volume
+  products.clear();
+  for (int i = 0; i < event.size(); ++i) {
+    if (event[i].status() < 0 && event[i].tau() <= 0.) continue;
+    RHadronDecayLibrary::Product product;
+    product.pdgId = event[i].id();
+    product.status = event[i].status();
+    product.p[0] = event[i].px(); product.p[1] = event[i].py(); product.p[2] = event[i].pz(); product.p[3] = event[i].e();
+    product.vProd[0] = event[i].xProd(); product.vProd[1] = event[i].yProd(); product.vProd[2] = event[i].zProd(); product.vProd[3] = event[i].tProd();
+    product.vDec[0] = event[i].xDec(); product.vDec[1] = event[i].yDec(); product.vDec[2] = event[i].zDec(); product.vDec[3] = event[i].tDec();
+    products.push_back(product);
+  }
+  return true;
+}
+
+
+void RHadronPythiaDecayer::fillParticle(const G4Track& aTrack, Pythia8::Event& event) const
+{
   // Get particle mass and 4-momentum.
   double mass = aTrack.GetDynamicParticle()->GetMass() / CLHEP::GeV;
   const G4LorentzVector g4p4 = aTrack.GetDynamicParticle()->Get4Momentum() / CLHEP::GeV;
   Pythia8::Vec4 p4(g4p4.px(), g4p4.py(), g4p4.pz(), g4p4.e());
 
   // Store the particle in the event record.
-  event.append( aTrack.GetDefinition()->GetPDGEncoding(), 1, 0, 0, p4, mass);
+  fillParticle(aTrack.GetDefinition()->GetPDGEncoding(), mass, p4, event);
 }
 
 
-void RHadronPythiaDecayer::RHadronToConstituents(Pythia8::Event& event) {
+void RHadronPythiaDecayer::fillParticle(int pdgId, double mass, const Pythia8::Vec4& p4, Pythia8::Event& event)
+{
+  // Reset event record to allow for new event.
+  event.reset();
+
+  // Store the particle in the event record.
+  event.append( pdgId, 1, 0, 0, p4, mass);
+}
+
+
+void RHadronPythiaDecayer::RHadronToConstituents(Pythia8::Pythia& pythia, const SparticleIds& ids) {
   // This code is very similar to Pythia8::RHadrons::decay(). Unfortunately, it is not possible in this scenario to use Pythia8::RHadrons::decay().
   // Because we need to use a new instance of pythia, the value of nRHad inside of Pythia8::RHadrons is set to 0 and the for loop inside of Pythia8::RHadrons::decay() never runs.
   // As far as I'm aware, it is impossible to update nRHad without first producing R-hadrons with the pythia instance, which is not what we want to do.
   // So, in lieu of this, code from Pythia8::RHadrons::decay() has been pasted here rather than used directly.
 
-  Pythia8::ParticleData& pdt = pythia_->particleData;
+  Pythia8::Event& event = pythia.event;
+  Pythia8::ParticleData& pdt = pythia.particleData;
 
   int    iRNow  = 1;
   int    idRHad = event[iRNow].id();
@@ -182,26 +628,29 @@ void RHadronPythiaDecayer::RHadronToConstituents(Pythia8::Event& event) {
   int    iR0    = 0;
   int    iR2    = 0;
 
-  bool isTriplet = !isGluinoRHadron(idRHad);
+  // Find flavour content of squark or gluino R-hadron from the precomputed table.
+  const rhadron::FlavourEntry* flavour = rhadron::findFlavourEntry(idRHad);
+  if (!flavour) {
+    edm::LogError("SimG4CoreCustomPhysics") << "RHadronPythiaDecayer::RhadronToConstituents: Unknown R-hadron " << idRHad;
+    return;
+  }
+  bool isTriplet = !flavour->isOctet;
 
-  // Find flavour content of squark or gluino R-hadron.
-  std::pair<int,int> idPair = (isTriplet) ? fromIdWithSquark( idRHad) : fromIdWithGluino( idRHad, &(pythia_->rndm));
-  int id1 = idPair.first;
-  int id2 = idPair.second;
+  // Only gluinoballs and gluino baryons have more than one possible splitting
+  const double u = (flavour->nChoices > 1) ? pythia.rndm.flat() : 0.;
+  rhadron::Constituents constituents = rhadron::selectConstituents(*flavour, u);
+  if (idRHad < 0) constituents = rhadron::conjugate(constituents, flavour->isOctet);
+  int id2 = constituents.id2;
 
   // Sharing of momentum: the squark/gluino should be restored
   // to original mass, but error if negative-mass spectators.
-  int idRSb            = pythia_->settings.mode("RHadrons:idSbottom");
-  int idRSt            = pythia_->settings.mode("RHadrons:idStop");
-  int idRGo            = pythia_->settings.mode("RHadrons:idGluino");
-  int idLight = (abs(idRHad) - 1000000) / 10;
-  int idSq    = (idLight < 100) ? idLight/10 : idLight/100;
-  int idRSq     = (idSq == 6) ? idRSt : idRSb;
+  int idRSq = (flavour->sparticleId == 1000006) ? ids.stop : ids.sbottom;
 
   // Handling R-Hadrons with anti-squarks
   idRSq = idRSq * std::copysign(1, idRHad);
 
-  int idRBef = isTriplet ? idRSq : idRGo;
+  int idRBef = isTriplet ? idRSq : ids.gluino;
+  int id1 = isTriplet ? idRSq : constituents.id1;
 
   // Mass of the underlying sparticle
   double mRBef = pdt.mSel(idRBef);
@@ -230,8 +679,8 @@ void RHadronPythiaDecayer::RHadronToConstituents(Pythia8::Event& event) {
   // Gluino case
   else{
     double mOffsetCloudRH = 0.2; // could be read from internal data?
-    double m1Eff  = pdt.constituentMass(id1) + mOffsetCloudRH;
-    double m2Eff  = pdt.constituentMass(id2) + mOffsetCloudRH;
+    double m1Eff  = constituents.mass1 + mOffsetCloudRH;
+    double m2Eff  = constituents.mass2 + mOffsetCloudRH;
     double frac1 = (1. - fracR) * m1Eff / ( m1Eff + m2Eff);
     double frac2 = (1. - fracR) * m2Eff / ( m1Eff + m2Eff);
 
@@ -255,98 +704,3 @@ void RHadronPythiaDecayer::RHadronToConstituents(Pythia8::Event& event) {
       event[iRd].vProd( vDec);
     }
 }
-
-
-std::pair<int,int> RHadronPythiaDecayer::fromIdWithSquark( int idRHad) const
-{
-  // Find squark flavour content.
-  int idRSb            = pythia_->settings.mode("RHadrons:idSbottom");
-  int idRSt            = pythia_->settings.mode("RHadrons:idStop");
-  int idLight = (abs(idRHad) - 1000000) / 10;
-  int idSq    = (idLight < 100) ? idLight/10 : idLight/100;
-  int id1     = (idSq == 6) ? idRSt : idRSb;
-  if (idRHad < 0) id1 = -id1;
-
-  // Find light (di)quark flavour content.
-  int id2     =  (idLight < 100) ? idLight%10 : idLight%100;
-  if (id2 > 10) id2 = 100 * id2 + abs(idRHad)%10;
-  if ((id2 < 10 && idRHad > 0) || (id2 > 10 && idRHad < 0)) id2 = -id2;
-
-  return std::make_pair( id1, id2);
-}
-
-
-std::pair<int,int> RHadronPythiaDecayer::fromIdWithGluino( int idRHad, Pythia8::Rndm* rndmPtr) const
-{
-  // Find light flavour content of R-hadron.
-  int idLight = (abs(idRHad) - 1000000) / 10;
-  int id1, id2, idTmp, idA, idB, idC;
-  double diquarkSpin1RH = 0.5;
-
-  // Gluinoballs: split g into d dbar or u ubar.
-  if (idLight < 100) {
-    id1 = (rndmPtr->flat() < 0.5) ? 1 : 2;
-    id2 = -id1;
-
-  // Gluino-meson: split into q + qbar.
-  } else if (idLight < 1000) {
-    id1 = (idLight / 10) % 10;
-    id2 = -(idLight % 10);
-    // Flip signs when first quark of down-type.
-    if (id1%2 == 1) {
-      idTmp = id1;
-      id1   = -id2;
-      id2   = -idTmp;
-    }
-
-  // Gluino-baryon: split to q + qq (diquark).
-  // Pick diquark at random, except if c or b involved.
-  } else {
-    idA = (idLight / 100) % 10;
-    idB = (idLight / 10) % 10;
-    idC = idLight % 10;
-    double rndmQ = 3. * rndmPtr->flat();
-    if (idA > 3) rndmQ = 0.5;
-    if (rndmQ < 1.) {
-      id1 = idA;
-      id2 = 1000 * idB + 100 * idC + 3;
-      if (idB != idC && rndmPtr->flat() > diquarkSpin1RH) id2 -= 2;
-    } else if (rndmQ < 2.) {
-      id1 = idB;
-      id2 = 1000 * idA + 100 * idC + 3;
-      if (idA != idC && rndmPtr->flat() > diquarkSpin1RH) id2 -= 2;
-    } else {
-      id1 = idC;
-      id2 = 1000 * idA + 100 * idB +3;
-      if (idA != idB && rndmPtr->flat() > diquarkSpin1RH) id2 -= 2;
-    }
-  }
-  // Flip signs for anti-R-hadron.
-  if (idRHad < 0) {
-    idTmp = id1;
-    id1   = -id2;
-    id2   = -idTmp;
-  }
-
-  return std::make_pair( id1, id2);
-}
-
-
-bool RHadronPythiaDecayer::isGluinoRHadron(int pdgId) const
-{
-  // Checking what kind of RHadron this is based on the digits in its PDGID
-  const unsigned short digitValue_q1 = nth_digit(pdgId,4);
-  const unsigned short digitValue_l = nth_digit(pdgId,5);
-
-  // Gluino R-Hadrons have the form 109xxxx or 1009xxx
-  if (digitValue_l == 9 || (digitValue_l==0 && digitValue_q1 == 9) ){
-    // This is a gluino R-Hadron
-    return true;
-  }
-
-  // Special case : R-gluinoball
-  if (pdgId==1000993) return true;
-
-  // This is not a gluino R-Hadron (probably a squark R-Hadron)
-  return false;
-}
\ No newline at end of file
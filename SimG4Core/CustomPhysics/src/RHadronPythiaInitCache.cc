@@ -0,0 +1,131 @@
+#include "SimG4Core/CustomPhysics/interface/RHadronPythiaInitCache.h"
+#include "SimG4Core/CustomPhysics/interface/RHadronInputHash.h"
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "Pythia8/Pythia.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <unistd.h>
+
+RHadronPythiaInitCache::RHadronPythiaInitCache(const std::string& fileName,
+                                               const std::string& slhaFile,
+                                               const std::vector<std::string>& commands)
+    : fileName_(fileName), loaded_(false) {
+  uint64_t salt;
+  std::memcpy(&salt, kMagic, sizeof(salt));
+  inputHash_ = rhadron::inputHash(salt ^ kVersion, slhaFile, commands);
+}
+
+bool RHadronPythiaInitCache::load() {
+  if (fileName_.empty())
+    return false;
+  std::ifstream in(fileName_, std::ios::binary);
+  if (!in.is_open())
+    return false;
+
+  Header header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.pythiaVersion != PYTHIA_VERSION_INTEGER) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: " << fileName_
+                                              << " is not an init cache of this version of Pythia8. It will be rebuilt.";
+    return false;
+  }
+  if (header.inputHash != inputHash_) {
+    edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: " << fileName_
+                                               << " was built from a different SLHA file or command file. It will be rebuilt.";
+    return false;
+  }
+
+  settingsXML_.resize(header.settingsSize);
+  particleDataXML_.resize(header.particleDataSize);
+  if (!in.read(&settingsXML_[0], header.settingsSize) || !in.read(&particleDataXML_[0], header.particleDataSize)) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: " << fileName_ << " is truncated. It will be rebuilt.";
+    settingsXML_.clear();
+    particleDataXML_.clear();
+    return false;
+  }
+
+  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: Restoring Pythia8 initialization from " << fileName_;
+  loaded_ = true;
+  return true;
+}
+
+void RHadronPythiaInitCache::capture(Pythia8::Pythia& pythia) {
+  std::ostringstream settingsStream;
+  pythia.settings.writeFileXML(settingsStream);
+  settingsXML_ = settingsStream.str();
+
+  // ParticleData can only list its XML to a file. It goes to a private temporary file, as the working directory of
+  // the job may be shared or read-only
+  const char* tmpDir = std::getenv("TMPDIR");
+  std::string tmpFileName = std::string((tmpDir && *tmpDir) ? tmpDir : "/tmp") + "/RHadronPythiaInitCache.XXXXXX";
+  const int fd = ::mkstemp(&tmpFileName[0]);
+  if (fd < 0) {
+    edm::LogWarning("SimG4CoreCustomPhysics")
+        << "RHadronPythiaInitCache: Could not create a temporary file. Pythia8 will be initialized on every thread.";
+    settingsXML_.clear();
+    return;
+  }
+  ::close(fd);
+  pythia.particleData.listXML(tmpFileName);
+  std::ifstream particleDataStream(tmpFileName, std::ios::binary);
+  particleDataXML_.assign(std::istreambuf_iterator<char>(particleDataStream), std::istreambuf_iterator<char>());
+  particleDataStream.close();
+  std::remove(tmpFileName.c_str());
+
+  loaded_ = !settingsXML_.empty() && !particleDataXML_.empty();
+  if (loaded_ && !fileName_.empty())
+    save();
+}
+
+std::unique_ptr<Pythia8::Pythia> RHadronPythiaInitCache::restore() const {
+  std::istringstream settingsStream(settingsXML_);
+  std::istringstream particleDataStream(particleDataXML_);
+  auto pythia = std::make_unique<Pythia8::Pythia>(settingsStream, particleDataStream, false);
+
+  // The particle data already contain the SLHA spectrum and decays, and the full listings were printed when the snapshot was taken
+  pythia->readString("SLHA:readFrom = 0");
+  pythia->readString("Init:showAllParticleData = off");
+  pythia->readString("Init:showAllSettings = off");
+  pythia->readString("Init:showChangedParticleData = off");
+  pythia->readString("Init:showChangedSettings = off");
+  return pythia;
+}
+
+bool RHadronPythiaInitCache::save() const {
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.pythiaVersion = PYTHIA_VERSION_INTEGER;
+  header.inputHash = inputHash_;
+  header.settingsSize = settingsXML_.size();
+  header.particleDataSize = particleDataXML_.size();
+
+  // Write to a temporary name and rename, so concurrent jobs never read a partial cache
+  const std::string tmpFileName = fileName_ + ".tmp." + std::to_string(::getpid());
+  std::ofstream out(tmpFileName, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: Could not open " << tmpFileName << " for writing.";
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  out.write(settingsXML_.data(), settingsXML_.size());
+  out.write(particleDataXML_.data(), particleDataXML_.size());
+  out.close();
+  if (!out || std::rename(tmpFileName.c_str(), fileName_.c_str()) != 0) {
+    edm::LogWarning("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: Failed to write " << fileName_;
+    std::remove(tmpFileName.c_str());
+    return false;
+  }
+
+  edm::LogVerbatim("SimG4CoreCustomPhysics") << "RHadronPythiaInitCache: Wrote Pythia8 initialization to " << fileName_;
+  return true;
+}
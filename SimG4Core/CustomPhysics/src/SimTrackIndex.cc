@@ -0,0 +1,29 @@
+#include "SimG4Core/CustomPhysics/interface/SimTrackIndex.h"
+
+#include <algorithm>
+
+void SimTrackIndex::build(const edm::SimTrackContainer& tracks) {
+  tracks_ = &tracks;
+  dense_.clear();
+  sparse_.clear();
+  if (tracks.empty())
+    return;
+
+  unsigned int maxID = 0;
+  for (const auto& track : tracks)
+    maxID = std::max(maxID, track.trackId());
+
+  // A flat array at most a few times larger than the collection, otherwise a hash map
+  if (maxID / 4 <= tracks.size() + 1024) {
+    dense_.assign(static_cast<std::size_t>(maxID) + 1, kMissing);
+    for (std::uint32_t i = 0; i < tracks.size(); ++i) {
+      // Keep the first SimTrack of an ID, as a linear search would
+      if (dense_[tracks[i].trackId()] == kMissing)
+        dense_[tracks[i].trackId()] = i;
+    }
+  } else {
+    sparse_.reserve(tracks.size());
+    for (std::uint32_t i = 0; i < tracks.size(); ++i)
+      sparse_.emplace(tracks[i].trackId(), i);
+  }
+}
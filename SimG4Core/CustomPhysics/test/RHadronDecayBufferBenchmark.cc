@@ -0,0 +1,133 @@
+// Micro-benchmark of the conversion of R-hadron decay products to the lab frame: the SoA kernel of RHadronDecayBuffer
+// against the per-product CLHEP conversion it replaced in RHadronPythiaDecayer. Also checks that both agree on the
+// momenta, the displacements and the absolute vertices.
+//
+// Usage: benchmarkRHadronDecayBuffer [number of products per decay] [number of decays]
+
+#include "SimG4Core/CustomPhysics/interface/RHadronDecayBuffer.h"
+
+#include "G4LorentzVector.hh"
+#include "G4ThreeVector.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+  struct Product {
+    int pdgId;
+    int status;
+    double p[4];
+    double vProd[4];
+    double vDec[4];
+  };
+
+  // Products displaced by 1 mm to 1 m from the R-hadron decay, as for decays of long-lived sparticles, with their
+  // time of flight. Every other product is decayed again 1 mm to 1 m further along its momentum
+  std::vector<Product> makeDecay(std::mt19937_64& engine, unsigned int nProducts) {
+    std::uniform_real_distribution<double> momentum(-5., 5.);
+    std::uniform_real_distribution<double> logDistance(0., 3.);
+    std::uniform_real_distribution<double> cosTheta(-1., 1.);
+    std::uniform_real_distribution<double> phi(0., 2. * M_PI);
+    std::vector<Product> decay(nProducts);
+    for (unsigned int n = 0; n < nProducts; ++n) {
+      Product& product = decay[n];
+      product.pdgId = 211;
+      product.status = (n % 2) ? -91 : 91;
+      product.p[0] = momentum(engine);
+      product.p[1] = momentum(engine);
+      product.p[2] = momentum(engine);
+      product.p[3] = std::sqrt(product.p[0] * product.p[0] + product.p[1] * product.p[1] + product.p[2] * product.p[2] +
+                               0.13957 * 0.13957);
+
+      const double distance = std::pow(10., logDistance(engine));
+      const double cos = cosTheta(engine), sin = std::sqrt(1. - cos * cos), angle = phi(engine);
+      product.vProd[0] = distance * sin * std::cos(angle);
+      product.vProd[1] = distance * sin * std::sin(angle);
+      product.vProd[2] = distance * cos;
+      product.vProd[3] = distance;
+
+      const double flight = (product.status < 0) ? std::pow(10., logDistance(engine)) : 0.;
+      const double pMag = std::sqrt(product.p[3] * product.p[3] - 0.13957 * 0.13957);
+      for (int i = 0; i < 3; ++i)
+        product.vDec[i] = product.vProd[i] + flight * product.p[i] / pMag;
+      product.vDec[3] = product.vProd[3] + flight * product.p[3] / pMag;
+    }
+    return decay;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  const unsigned int nProducts = (argc > 1) ? std::atoi(argv[1]) : 30;
+  const unsigned int nDecays = (argc > 2) ? std::atoi(argv[2]) : 200000;
+
+  std::mt19937_64 engine(12345);
+  const std::vector<Product> decay = makeDecay(engine, nProducts);
+  const G4ThreeVector beta(0.3, -0.2, 0.6);
+  const G4ThreeVector origin(120., -35., 870.);
+
+  // Per-product conversion with CLHEP temporaries
+  std::vector<G4LorentzVector> momenta;
+  std::vector<G4ThreeVector> displacements, vProds, vDecs;
+  double checksum = 0.;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int n = 0; n < nDecays; ++n) {
+    momenta.clear();
+    displacements.clear();
+    vProds.clear();
+    vDecs.clear();
+    for (const auto& product : decay) {
+      G4ThreeVector displacement =
+          G4LorentzVector(product.vProd[0], product.vProd[1], product.vProd[2], product.vProd[3]).boost(beta).vect();
+      G4ThreeVector vProd = origin + displacement;
+      G4ThreeVector vDec =
+          origin + G4LorentzVector(product.vDec[0], product.vDec[1], product.vDec[2], product.vDec[3]).boost(beta).vect();
+      G4LorentzVector p4(product.p[0], product.p[1], product.p[2], product.p[3]);
+      p4.boost(beta);
+      p4 *= 1000.0;
+      momenta.push_back(p4);
+      displacements.push_back(displacement);
+      vProds.push_back(vProd);
+      vDecs.push_back(vDec);
+      checksum += vProd.z() + vDec.z();
+    }
+  }
+  const double clhepNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  // SoA kernel
+  RHadronDecayBuffer buffer;
+  start = std::chrono::steady_clock::now();
+  for (unsigned int n = 0; n < nDecays; ++n) {
+    buffer.clear();
+    for (const auto& product : decay)
+      buffer.add(product.pdgId, product.status, product.p, product.vProd, product.vDec);
+    buffer.toLab(beta, origin);
+    checksum -= buffer.zProd()[0] + buffer.zDec()[0];
+  }
+  const double bufferNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  double maxDifference = 0.;
+  for (unsigned int i = 0; i < nProducts; ++i) {
+    maxDifference = std::max(maxDifference, (buffer.p4(i) - momenta[i]).rho() + std::abs(buffer.p4(i).e() - momenta[i].e()));
+    maxDifference = std::max(maxDifference, (buffer.displacement(i) - displacements[i]).mag());
+    maxDifference = std::max(
+        maxDifference, (G4ThreeVector(buffer.xProd()[i], buffer.yProd()[i], buffer.zProd()[i]) - vProds[i]).mag());
+    // The decay vertex is only used for decayed products
+    if (buffer.decayed()[i])
+      maxDifference = std::max(
+          maxDifference, (G4ThreeVector(buffer.xDec()[i], buffer.yDec()[i], buffer.zDec()[i]) - vDecs[i]).mag());
+  }
+
+  const double perProduct = 1. / (double(nDecays) * nProducts);
+  std::cout << "RHadronDecayBuffer benchmark: " << nDecays << " decays of " << nProducts << " products\n"
+            << "  per-product CLHEP conversion: " << clhepNs * perProduct << " ns/product\n"
+            << "  SoA toLab kernel:             " << bufferNs * perProduct << " ns/product\n"
+            << "  speed-up:                     " << clhepNs / bufferNs << "\n"
+            << "  max difference:               " << maxDifference << " (checksum " << checksum << ")" << std::endl;
+
+  return (maxDifference < 1e-6) ? 0 : 1;
+}
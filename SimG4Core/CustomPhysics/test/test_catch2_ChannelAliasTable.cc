@@ -0,0 +1,196 @@
+#include "catch.hpp"
+#include "SimG4Core/CustomPhysics/interface/ChannelAliasTable.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+static constexpr auto s_tag = "[ChannelAliasTable]";
+
+namespace {
+  // The channel selection loop of the flat model of G4ProcessHelper::GetFinalState that the alias tables replaced
+  std::size_t rejectionLoop(const std::vector<ChannelAliasTable::Channel>& channels,
+                            double p22,
+                            double suppression,
+                            std::mt19937_64& engine) {
+    std::uniform_real_distribution<double> flat(0., 1.);
+    std::size_t n22 = 0;
+    for (const auto& channel : channels)
+      if (channel.twoBody)
+        ++n22;
+    const std::size_t n23 = channels.size() - n22;
+
+    std::vector<double> probabilities;
+    double cumulated = 0.;
+    for (const auto& channel : channels) {
+      cumulated += channel.twoBody ? p22 / n22 : (1. - p22) / n23;
+      probabilities.push_back(cumulated);
+    }
+    for (double& probability : probabilities)
+      probability /= cumulated;
+
+    bool selected = false;
+    std::size_t i = 0;
+    for (int tries = 0; !selected && tries < 100; ++tries) {
+      const double dice = flat(engine);
+      i = 0;
+      while (i + 1 < channels.size() && dice > probabilities[i])
+        ++i;
+      selected = channels[i].twoBody || channels[i].acceptance > flat(engine);
+      if (selected && channels[i].chargeChange && flat(engine) < suppression)
+        selected = false;
+    }
+    return i;
+  }
+
+  // Pearson chi2 of observed counts against expected probabilities
+  double chi2(const std::vector<long>& counts, const std::vector<double>& probabilities, long n) {
+    double result = 0.;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      const double expected = probabilities[i] * n;
+      if (expected > 0.)
+        result += (counts[i] - expected) * (counts[i] - expected) / expected;
+    }
+    return result;
+  }
+
+  // Loose upper bound of the chi2 distribution, far in its tail
+  double chi2Limit(std::size_t dof) { return dof + 6. * std::sqrt(2. * dof); }
+
+  const std::vector<ChannelAliasTable::Channel> s_channels = {{true, 0., false},
+                                                              {false, 0.05, false},
+                                                              {true, 0., true},
+                                                              {false, 0.6, true},
+                                                              {false, 0.95, false},
+                                                              {true, 0., false},
+                                                              {false, 0.3, false}};
+}  // namespace
+
+TEST_CASE("Alias tables reproduce their weights", s_tag) {
+  const std::vector<double> weights = {0.1, 0., 3., 0.5, 1.2, 0.01, 2.};
+  ChannelAliasTable table;
+  table.addBin({1.});
+  const std::size_t bin = table.addBin(weights);
+  REQUIRE(table.size() == 2);
+  REQUIRE(table.binSize(bin) == weights.size());
+
+  double total = 0.;
+  for (double weight : weights)
+    total += weight;
+  std::vector<double> probabilities;
+  for (double weight : weights)
+    probabilities.push_back(weight / total);
+
+  std::mt19937_64 engine(1234);
+  std::uniform_real_distribution<double> flat(0., 1.);
+  const long n = 1000000;
+  std::vector<long> counts(weights.size(), 0);
+  long singleChannelMisses = 0;
+  for (long i = 0; i < n; ++i) {
+    singleChannelMisses += (table.sample(0, flat(engine)) != 0);
+    ++counts[table.sample(bin, flat(engine))];
+  }
+  REQUIRE(singleChannelMisses == 0);
+  REQUIRE(counts[1] == 0);
+  REQUIRE(chi2(counts, probabilities, n) < chi2Limit(weights.size() - 2));
+}
+
+TEST_CASE("Alias tables reproduce the rejection loop of GetFinalState", s_tag) {
+  const double p22 = 0.15;
+
+  for (double suppression : {0., 0.5, 0.9}) {
+    std::vector<double> weights;
+    ChannelAliasTable::channelWeights(s_channels, p22, suppression, weights);
+    ChannelAliasTable table;
+    const std::size_t bin = table.addBin(weights);
+
+    std::mt19937_64 engine(42);
+    std::uniform_real_distribution<double> flat(0., 1.);
+    const long n = 1000000;
+    std::vector<long> loopCounts(s_channels.size(), 0), aliasCounts(s_channels.size(), 0);
+    for (long i = 0; i < n; ++i) {
+      ++loopCounts[rejectionLoop(s_channels, p22, suppression, engine)];
+      ++aliasCounts[table.sample(bin, flat(engine))];
+    }
+
+    // Both against the exact weights, and against each other
+    REQUIRE(chi2(loopCounts, weights, n) < chi2Limit(s_channels.size() - 1));
+    REQUIRE(chi2(aliasCounts, weights, n) < chi2Limit(s_channels.size() - 1));
+    double twoSample = 0.;
+    for (std::size_t i = 0; i < s_channels.size(); ++i) {
+      const double sum = loopCounts[i] + aliasCounts[i];
+      if (sum > 0.)
+        twoSample += (loopCounts[i] - aliasCounts[i]) * (loopCounts[i] - aliasCounts[i]) / sum;
+    }
+    REQUIRE(twoSample < chi2Limit(s_channels.size() - 1));
+  }
+}
+
+TEST_CASE("Channel weights of single class and fully suppressed bins", s_tag) {
+  std::vector<double> weights;
+
+  // Only 2 -> 3 channels: the 2 -> 3 class gets all of the probability
+  ChannelAliasTable::channelWeights({{false, 0.2, false}, {false, 0.6, false}}, 0.15, 0., weights);
+  REQUIRE(weights[0] == Approx(0.25));
+  REQUIRE(weights[1] == Approx(0.75));
+
+  // Nothing can be accepted: the proposal probabilities, as when the loop gave up
+  ChannelAliasTable::channelWeights({{true, 0., true}, {false, 0.5, true}, {false, 0.5, true}}, 0.15, 1., weights);
+  REQUIRE(weights[0] == Approx(0.15));
+  REQUIRE(weights[1] == Approx(0.425));
+  REQUIRE(weights[2] == Approx(0.425));
+}
+
+TEST_CASE("Bins with bounded acceptances reproduce the weights at the exact sqrt(s)", s_tag) {
+  // Phase space factor of G4ProcessHelper, q in GeV
+  auto phaseSpace = [](double q) {
+    const double phi = std::sqrt(1 + q / (2 * 0.139)) * std::pow(q / 1.1, 3. / 2.);
+    return phi / (1 + phi);
+  };
+  // Thresholds of the channels of a 1 TeV gluino R-meson on a proton (2 -> 2 channels at the R-hadron plus nucleon
+  // mass, 2 -> 3 channels with an extra pion), sorted by threshold; the second channel changes the charge
+  struct TestChannel {
+    bool twoBody;
+    double massSum;
+    bool chargeChange;
+  };
+  const std::vector<TestChannel> channels = {{true, 1000.938, false},
+                                             {true, 1000.940, true},
+                                             {false, 1001.077, false},
+                                             {false, 1001.079, true},
+                                             {true, 1001.250, false},
+                                             {false, 1001.389, false}};
+  const double p22 = 0.15;
+  const double suppression = 0.5;
+
+  std::mt19937_64 engine(2024);
+  std::uniform_real_distribution<double> flat(0., 1.);
+  auto uniform = [&] { return flat(engine); };
+
+  // sqrt(s) just above each 2 -> 3 threshold, where the phase space factor changes fastest, and across a bin
+  for (double sqrts : {1001.0771, 1001.0775, 1001.079, 1001.0795, 1001.083, 1001.1, 1001.3895, 1001.5}) {
+    std::size_t nOpen = 0;
+    while (nOpen < channels.size() && channels[nOpen].massSum < sqrts)
+      ++nOpen;
+    // A bin reaching 2% beyond sqrt(s) in the distance to the highest open threshold, as in BuildFlatModelBins
+    const double upper = channels[nOpen - 1].massSum + 1.02 * (sqrts - channels[nOpen - 1].massSum);
+
+    std::vector<ChannelAliasTable::Channel> bounded, exact;
+    for (std::size_t i = 0; i < nOpen; ++i) {
+      bounded.push_back({channels[i].twoBody, phaseSpace(upper - channels[i].massSum), channels[i].chargeChange});
+      exact.push_back({channels[i].twoBody, phaseSpace(sqrts - channels[i].massSum), channels[i].chargeChange});
+    }
+    std::vector<double> weights, exactWeights;
+    ChannelAliasTable::channelWeights(bounded, p22, suppression, weights);
+    ChannelAliasTable::channelWeights(exact, p22, suppression, exactWeights);
+    ChannelAliasTable table;
+    const std::size_t bin = table.addBin(weights);
+
+    auto ratio = [&](std::size_t i) { return channels[i].twoBody ? 1. : exact[i].acceptance / bounded[i].acceptance; };
+    const long n = 1000000;
+    std::vector<long> counts(nOpen, 0);
+    for (long i = 0; i < n; ++i)
+      ++counts[table.sample(bin, uniform, ratio)];
+    REQUIRE(chi2(counts, exactWeights, n) < chi2Limit(nOpen - 1));
+  }
+}